@@ -0,0 +1,32 @@
+#!/bin/sh
+
+# Builds the headless platform layer, which runs the editor from a scene script without a window.
+# See the top of code/TextEditor_headless.cpp for how to use it.
+# ./build.sh test also runs the checks afterwards, exiting with 1 if any fail. The golden frames in tests/ were
+# drawn with Source Code Pro Regular, which isn't in the repo, so pass its path to check them too:
+#   ./build.sh test path/to/SourceCodePro-Regular.ttf
+
+# -Wno-write-strings because string literals are passed around as char*
+# -fno-exceptions and -fno-rtti match -EHa- and -GR- in build.bat
+commonCompilerFlags="-std=c++17 -O2 -g -Wno-write-strings -fno-exceptions -fno-rtti"
+libraries="-lpthread"
+includeDirs="includes"
+
+c++ $commonCompilerFlags code/TextEditor_headless.cpp -I $includeDirs $libraries -o TextEditor_headless || exit 1
+
+if [ "$1" = "test" ]; then
+    # The SIMD blit kernels have to give exactly what the scalar ones do
+    ./TextEditor_headless -selftest || exit 1
+
+    if [ -n "$2" ]; then
+        # The scene edits the file it opens, so it gets a copy of the sample
+        tmp=$(mktemp -d) || exit 1
+        cp tests/sample.cpp "$tmp/sample.cpp"
+        ./TextEditor_headless -font "$2" -size 800x360 -dump "$tmp" -golden tests/golden/edit tests/edit.txt "$tmp/sample.cpp"
+        result=$?
+        rm -rf "$tmp"
+        [ $result -eq 0 ] || exit 1
+    else
+        echo "No font given, skipping the golden frames in tests/golden"
+    fi
+fi
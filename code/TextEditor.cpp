@@ -1,4 +1,6 @@
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 #include "TextEditor.h"
 #include "TextEditor_input.h"
@@ -6,6 +8,10 @@
 #include "TextEditor_font.h"
 #include "TextEditor_config.h"
 #include "TextEditor_tokeniser.h"
+#include "TextEditor_blit.h"
+#include "TextEditor_hash.h"
+#include "TextEditor_dynarray.h"
+#include "TextEditor_stats.h"
 
 #define MAX_LINE_NUM_DIGITS 6
 #define PIXELS_UNDER_BASELINE 5
@@ -18,109 +24,313 @@ const Allocator lineMemoryAllocator = {LineMemory_Alloc, LineMemory_Realloc, Lin
 //extern Font font;
 //extern ScreenBuffer screenBuffer;
 
-struct TimedEvent
+//
+//TIMERS
+//
+
+//Goes off after the delay it's started with, then every interval after that until it's stopped (or just
+//once if interval is 0). Everything timed, like the cursor blink and key repeat, is one of these so the
+//platform can ask when the next one is due and sleep until then.
+struct Timer
 {
     float interval;
     KeyCallback onTrigger = {0};
-    float elapsedTime = 0.0f;
+    double deadline = 0.0;
+    bool running = false;
 };
 
-void HandleTimedEvent(TimedEvent* timedEvent, float dt, TimedEvent* nestedEvent, Editor* editor = nullptr)
+//There's only a handful of timers, so finding the next one is a scan rather than anything sorted
+#define MAX_RUNNING_TIMERS 16
+
+global Timer* runningTimers[MAX_RUNNING_TIMERS];
+global int numRunningTimers;
+global double timerClock; //Sum of every dt passed to RunTimers
+
+//Restarts the timer if it's already running
+void StartTimer(Timer* timer, float delay)
+{
+    timer->deadline = timerClock + delay;
+    if (!timer->running)
+    {
+        Assert(numRunningTimers < MAX_RUNNING_TIMERS);
+        runningTimers[numRunningTimers++] = timer;
+        timer->running = true;
+    }
+}
+
+void StopTimer(Timer* timer)
 {
-    timedEvent->elapsedTime += dt;
-    if (timedEvent->elapsedTime >= timedEvent->interval)
+    if (!timer->running) return;
+
+    for (int i = 0; i < numRunningTimers; ++i)
     {
-        if (timedEvent->onTrigger.voidFunc) //May not be needed???
+        if (runningTimers[i] == timer)
         {
-            if (timedEvent->onTrigger.isEditorFunc) timedEvent->onTrigger.editorFunc(editor); 
-            else timedEvent->onTrigger.voidFunc();
+            runningTimers[i] = runningTimers[--numRunningTimers];
+            break;
         }
-        
-        if (nestedEvent)
-        {
-            nestedEvent->elapsedTime += dt;
-            if (nestedEvent->elapsedTime >= nestedEvent->interval)
-            {
-				if (nestedEvent->onTrigger.voidFunc)
-				{
-					if (nestedEvent->onTrigger.isEditorFunc) nestedEvent->onTrigger.editorFunc(editor);
-					else nestedEvent->onTrigger.voidFunc();
-				}
+    }
+    timer->running = false;
+}
 
-                nestedEvent->elapsedTime = 0.0f;
-            }
+internal Timer* GetNextTimer()
+{
+    Timer* result = nullptr;
+    for (int i = 0; i < numRunningTimers; ++i)
+    {
+        if (!result || runningTimers[i]->deadline < result->deadline)
+            result = runningTimers[i];
+    }
+    return result;
+}
+
+//Fires every trigger that came due in dt in the order they were due, so a long frame
+//still gets the right number of key repeats
+void RunTimers(float dt, Editor* editor)
+{
+    timerClock += dt;
+    for (Timer* timer = GetNextTimer(); timer && timer->deadline <= timerClock; timer = GetNextTimer())
+    {
+        if (timer->interval > 0.0f) timer->deadline += timer->interval;
+        else StopTimer(timer);
+
+        //Triggers can start and stop timers, including this one
+        if (timer->onTrigger.voidFunc)
+        {
+            if (timer->onTrigger.isEditorFunc) timer->onTrigger.editorFunc(editor);
+            else timer->onTrigger.voidFunc();
         }
     }
 }
 
+//Negative if there are no timers running
+float SecondsUntilNextTimer()
+{
+    Timer* timer = GetNextTimer();
+    if (!timer) return -1.0f;
+    return (float)max(timer->deadline - timerClock, 0.0);
+}
+
 //Can only think that these are the only 3 needed. Chnge this in the future?
 enum CommandKeys
 {
     NONE  = 0b000,
     CTRL  = 0b001,
     ALT   = 0b010,
-    SHIFT = 0b100
+    SHIFT = 0b100,
+
+    ANY = 0b1000 //For bindings that don't care what's held, like the arrow keys which check shift and ctrl themselves
 };
 
+#define NUM_COMMAND_KEY_COMBOS 8
+
 CommandKeys operator|(CommandKeys a, CommandKeys b)
 {
     return (CommandKeys)((byte)a | (byte)b);
 }
 
+//What happens around a key binding's callback when it's called
+enum KeyBindingFlags
+{
+    KEYBINDING_MODIFIES_TEXT = 0b01, //The text is retokenised afterwards
+    KEYBINDING_MOVES_CURSOR  = 0b10  //Repeats while the key is held, and ends any highlight unless shift is held
+};
+
 struct KeyBinding
 {
     CommandKeys commandKeys; //Keys like ctrl, shift and alt which are usually held before actual key
     InputCode mainKey;
     KeyCallback callback;
+    byte flags = 0;
+};
+
+#define MAX_CALLBACKS_PER_KEY 4
+
+struct BoundCallback
+{
+    KeyCallback callback;
+    byte flags;
 };
 
-bool KeyCommandDown(KeyBinding keyBinding)
+//Everything bound to a key for one combination of command keys, called in the order they were bound
+struct BoundKey
 {
-	if (InputDown(input.letterKeys['L' - 'A']))
-	{
-		Assert(true);
-	}
+    BoundCallback callbacks[MAX_CALLBACKS_PER_KEY];
+    int numCallbacks;
+};
 
-    Assert(keyBinding.commandKeys);
+//Indexed by the command keys held and then the key that went down, so a key press is a single lookup
+global BoundKey boundKeys[NUM_COMMAND_KEY_COMBOS][NUM_INPUTS];
 
-    bool mainKeyDown = InputDown(input.flags[keyBinding.mainKey]);
-    
-    byte heldCommandKeys = 0b000;
-    heldCommandKeys |= (byte)InputHeld(input.leftCtrl);
-    heldCommandKeys |= (byte)InputHeld(input.leftAlt) << 1;
-    heldCommandKeys |= (byte)InputHeld(input.leftShift) << 2;
-    
-    return mainKeyDown && (heldCommandKeys == keyBinding.commandKeys);
+void BindKey(CommandKeys commandKeys, InputCode mainKey, KeyCallback callback, byte flags = 0)
+{
+    for (int combo = 0; combo < NUM_COMMAND_KEY_COMBOS; ++combo)
+    {
+        if (commandKeys != ANY && commandKeys != combo) continue;
+
+        BoundKey* boundKey = &boundKeys[combo][mainKey];
+        Assert(boundKey->numCallbacks < MAX_CALLBACKS_PER_KEY);
+        boundKey->callbacks[boundKey->numCallbacks++] = {callback, flags};
+    }
 }
 
-int TextPixelLength(char* text, int len)
+internal byte GetHeldCommandKeys()
 {
-    int result = 0;
-    for (int i = 0; i < len; i++)
-        result += fontData.chars[text[i]].advance;
+    byte result = NONE;
+    if (InputHeld(input.leftCtrl)) result |= CTRL;
+    if (InputHeld(input.leftAlt)) result |= ALT;
+    if (InputHeld(input.leftShift)) result |= SHIFT;
     return result;
 }
 
 int TextPixelLength(string text)
 {
     int result = 0;
-    for (int i = 0; i < text.len; i++)
-        result += fontData.chars[text[i]].advance;
+    for (int i = 0, charLen; i < text.len; i += charLen)
+        result += GetFontChar(DecodeUTF8(text, i, &charLen))->advance;
+    return result;
+}
+
+//
+//LINE ADVANCES
+//
+
+//Edits mark the lines they change. Ones that add or remove lines mark every line from there down,
+//since the lines below are moved along the array but their advances and hashes aren't.
+internal void MarkLinesChanged(Editor* editor, int firstLine, int onePastLastLine)
+{
+    onePastLastLine = min(onePastLastLine, MAX_LINES);
+    for (int i = max(firstLine, 0); i < onePastLastLine; ++i)
+    {
+        editor->lineAdvances[i].stale = true;
+        editor->lineHashes[i].stale = true;
+    }
+}
+
+internal LineAdvances* GetLineAdvances(Editor* editor, int lineIndex)
+{
+    LineAdvances* result = &editor->lineAdvances[lineIndex];
+    string line = editor->lines[lineIndex].toStr();
+    if (!result->stale)
+    {
+        Assert(result->len == line.len); //An edit that didn't mark its line
+        return result;
+    }
+
+    if (result->size < line.len + 1)
+    {
+        result->size = max(line.len + 1, 64);
+        result->prefix = HeapRealloc(int, result->prefix, result->size);
+    }
+    result->len = line.len;
+    result->stale = false;
+
+    //A char's advance goes on its last byte, so the columns inside a multi-byte char are at its left edge
+    result->prefix[0] = 0;
+    for (int i = 0, charLen; i < line.len; i += charLen)
+    {
+        int advance = GetFontChar(DecodeUTF8(line, i, &charLen))->advance;
+        for (int j = 1; j < charLen; ++j)
+            result->prefix[i + j] = result->prefix[i];
+        result->prefix[i + charLen] = result->prefix[i] + advance;
+    }
+
     return result;
 }
 
+//Pixel length of the first column chars of the line
+int LineColumnToX(Editor* editor, int lineIndex, int column)
+{
+    Assert(column >= 0);
+    LineAdvances* advances = GetLineAdvances(editor, lineIndex);
+    return advances->prefix[min(column, advances->len)];
+}
+
+internal int AdvancesXToColumn(LineAdvances* advances, int x)
+{
+    int low = 0;
+    int high = advances->len;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (advances->prefix[mid] < x) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+//The first column that starts at or after x, the line's length if none do
+int LineXToColumn(Editor* editor, int lineIndex, int x)
+{
+    return AdvancesXToColumn(GetLineAdvances(editor, lineIndex), x);
+}
+
 //
 //DRAWING FUNCTIONS
 //
 
-void DrawRect(Rect rect, Colour colour, Rect limits = {0})
+//Everything drawn is clipped to this, so a frame only has to redraw the parts of the screen that changed
+global Rect drawRegion;
+//Where the drawing functions draw to, only ever something other than the screen when filling caches
+global ScreenBuffer* drawTarget = &screenBuffer;
+
+//The screen is drawn by recording everything into a display list on the main thread, then splitting the 
+//screen into horizontal bands that worker threads rasterise from the list. Each band only writes its own 
+//rows and draws the commands in order, so the result is the same as drawing everything on one thread.
+#define MAX_DRAW_BANDS 32
+#define MIN_DRAW_BAND_PIXELS (64 * 1024) //Less than this isn't worth handing to another thread
+
+enum DrawCommandType : uint8
 {
-    Assert(rect.left <= rect.right);
-    Assert(rect.bottom <= rect.top);
+    DRAW_COMMAND_RECT,
+    DRAW_COMMAND_ALPHA_RECT,
+    DRAW_COMMAND_GLYPH,
+    DRAW_COMMAND_BITMAP
+};
+
+//Limits are already clipped to the draw region, bands only clip them further to their own rows
+struct DrawCommand
+{
+    DrawCommandType type;
+    Rect rect;
+    Rect limits;
+    union
+    {
+        Colour colour;
+        ColourRGBA alphaColour;
+        struct
+        {
+            uint32* glyphPixels; //Evicted glyphs' pixels aren't freed until the display list has been drawn
+            int stride;
+        };
+        uint32* pixels; //Bitmaps are rect sized
+    };
+};
+
+struct DisplayList
+{
+    bool recording = false;
+    DrawCommand* commands = nullptr;
+    int numCommands = 0;
+    int size = 0;
+};
+
+global DisplayList displayList;
 
-    if (!limits.right) limits.right = screenBuffer.width;
-    if (!limits.top) limits.top = screenBuffer.height;
+internal void RecordDrawCommand(DrawCommand command)
+{
+    if (RectIsEmpty(IntersectRects(command.rect, command.limits))) return;
+
+    if (displayList.size == 0)
+    {
+        displayList.size = 1024;
+        displayList.commands = HeapAlloc(DrawCommand, displayList.size);
+    }
+    AppendToDynamicArray(displayList.commands, displayList.numCommands, command, displayList.size);
+}
 
+internal void RasteriseRect(ScreenBuffer* target, Rect rect, Colour colour, Rect limits)
+{
     rect.left   = Clamp(rect.left,   limits.left, limits.right);
     rect.right  = Clamp(rect.right,  limits.left, limits.right);
     rect.bottom = Clamp(rect.bottom, limits.bottom, limits.top);
@@ -129,34 +339,17 @@ void DrawRect(Rect rect, Colour colour, Rect limits = {0})
     int drawWidth = rect.right - rect.left;
     int drawHeight = rect.top - rect.bottom;
 
-    int start = (rect.left + rect.bottom * screenBuffer.width) * PIXEL_IN_BYTES;
-	byte* row = (byte*)screenBuffer.memory + start;
+    int start = (rect.left + rect.bottom * target->width) * PIXEL_IN_BYTES;
+	byte* row = (byte*)target->memory + start;
 	for (int y = 0; y < drawHeight; ++y)
     {
-        byte* pixel = row;
-        for (int x = 0; x < drawWidth; ++x)
-        {
-            *pixel = colour.b;
-            pixel++;
-            *pixel = colour.g;
-            pixel++;
-            *pixel = colour.r;
-            pixel++;
-            *pixel = 0;
-            pixel++;
-        }
-		row += screenBuffer.width * PIXEL_IN_BYTES;
+        FillRow((uint32*)row, drawWidth, PackColour(colour));
+		row += target->width * PIXEL_IN_BYTES;
     }
 }
 
-void DrawAlphaRect(Rect rect, ColourRGBA colour, Rect limits = {0})
+internal void RasteriseAlphaRect(ScreenBuffer* target, Rect rect, ColourRGBA colour, Rect limits)
 {
-    Assert(rect.left <= rect.right);
-    Assert(rect.bottom <= rect.top);
-
-    if (!limits.right) limits.right = screenBuffer.width;
-    if (!limits.top) limits.top = screenBuffer.height;
-
     rect.left   = Clamp(rect.left,   limits.left, limits.right);
     rect.right  = Clamp(rect.right,  limits.left, limits.right);
     rect.bottom = Clamp(rect.bottom, limits.bottom, limits.top);
@@ -165,47 +358,18 @@ void DrawAlphaRect(Rect rect, ColourRGBA colour, Rect limits = {0})
     int drawWidth = rect.right - rect.left;
     int drawHeight = rect.top - rect.bottom;
 
-    int start = (rect.left + rect.bottom * screenBuffer.width) * PIXEL_IN_BYTES;
-	byte* row = (byte*)screenBuffer.memory + start;
+    int start = (rect.left + rect.bottom * target->width) * PIXEL_IN_BYTES;
+	byte* row = (byte*)target->memory + start;
 	for (int y = 0; y < drawHeight; ++y)
     {
-        byte* pixel = row;
-        for (int x = 0; x < drawWidth; ++x)
-        {
-            float alphaA = colour.a / 255.f;
-            float alphaB = 1.f;
-            float drawnAlpha = alphaA + alphaB * (1.f - alphaA);
-
-            byte pixelB = pixel[0];
-            byte pixelG = pixel[1];
-            byte pixelR = pixel[2];
-            byte drawnR = (byte)((colour.r*alphaA + pixelR*alphaB*(1 - alphaA)) / drawnAlpha);  
-            byte drawnG = (byte)((colour.g*alphaA + pixelG*alphaB*(1 - alphaA)) / drawnAlpha);  
-            byte drawnB = (byte)((colour.b*alphaA + pixelB*alphaB*(1 - alphaA)) / drawnAlpha);  
-            
-            *pixel = drawnB;
-            pixel++;
-            *pixel = drawnG;
-            pixel++;
-            *pixel = drawnR;
-            pixel++;
-            *pixel = 0;
-            pixel++;
-        }
-		row += screenBuffer.width * PIXEL_IN_BYTES;
+        BlendRow((uint32*)row, drawWidth, colour);
+		row += target->width * PIXEL_IN_BYTES;
     }
-
 }
 
-void Draw8bppPixels(Rect rect, uint8* pixels, int stride, Colour colour, Rect limits)
+//Rows are drawn from limits.top down to just above limits.bottom, one higher than the other functions
+internal void RasteriseGlyph(ScreenBuffer* target, Rect rect, uint32* glyphPixels, int stride, Rect limits)
 {
-    Assert(rect.left <= rect.right);
-    Assert(rect.bottom <= rect.top);
-
-    //TODO: There shouldn't be -1s at the end of these things, fix
-    if (!limits.right) limits.right = screenBuffer.width - 1;
-    if (!limits.top) limits.top = screenBuffer.height - 1;
-
     int pixelColStart = -min(0, rect.left - limits.left);
     int pixelRowStart = -min(0, limits.top - rect.top);
 
@@ -217,58 +381,213 @@ void Draw8bppPixels(Rect rect, uint8* pixels, int stride, Colour colour, Rect li
     int drawWidth = rect.right - rect.left;
     int drawHeight = rect.top - rect.bottom;
 
-    int start = (rect.left + rect.top * screenBuffer.width) * PIXEL_IN_BYTES;
-	uint8* row = (uint8*)screenBuffer.memory + start;
+    int start = (rect.left + rect.top * target->width) * PIXEL_IN_BYTES;
+	uint8* row = (uint8*)target->memory + start;
 	for (int y = 0; y < drawHeight; ++y)
     {
-        uint8* pixel = row;
-        for (int x = 0; x < drawWidth; ++x)
+        uint32* glyphRow = glyphPixels + stride * (y + pixelRowStart) + pixelColStart;
+        BlendPremultipliedRow((uint32*)row, glyphRow, drawWidth);
+		row -= target->width * PIXEL_IN_BYTES;
+    }
+}
+
+//Copies an opaque bitmap the size of rect, bottom row first like the screen
+internal void RasteriseBitmap(ScreenBuffer* target, Rect rect, uint32* pixels, Rect limits)
+{
+    Rect drawn = IntersectRects(rect, limits);
+    if (RectIsEmpty(drawn)) return;
+
+    int drawWidth = drawn.right - drawn.left;
+    int bitmapWidth = rect.right - rect.left;
+    for (int y = drawn.bottom; y < drawn.top; ++y)
+    {
+        uint32* src = pixels + (y - rect.bottom) * bitmapWidth + (drawn.left - rect.left);
+        uint32* dst = (uint32*)target->memory + y * target->width + drawn.left;
+        memcpy(dst, src, drawWidth * PIXEL_IN_BYTES);
+    }
+}
+
+void DrawRect(Rect rect, Colour colour, Rect limits = {0})
+{
+    Assert(rect.left <= rect.right);
+    Assert(rect.bottom <= rect.top);
+
+    if (!limits.right) limits.right = drawTarget->width;
+    if (!limits.top) limits.top = drawTarget->height;
+    limits = IntersectRects(limits, drawRegion);
+
+    if (displayList.recording)
+    {
+        DrawCommand command = {DRAW_COMMAND_RECT, rect, limits};
+        command.colour = colour;
+        RecordDrawCommand(command);
+    }
+    else
+    {
+        RasteriseRect(drawTarget, rect, colour, limits);
+    }
+}
+
+void DrawAlphaRect(Rect rect, ColourRGBA colour, Rect limits = {0})
+{
+    Assert(rect.left <= rect.right);
+    Assert(rect.bottom <= rect.top);
+
+    if (!limits.right) limits.right = drawTarget->width;
+    if (!limits.top) limits.top = drawTarget->height;
+    limits = IntersectRects(limits, drawRegion);
+
+    if (displayList.recording)
+    {
+        DrawCommand command = {DRAW_COMMAND_ALPHA_RECT, rect, limits};
+        command.alphaColour = colour;
+        RecordDrawCommand(command);
+    }
+    else
+    {
+        RasteriseAlphaRect(drawTarget, rect, colour, limits);
+    }
+}
+
+//Glyph pixels are already multiplied by their colour, so blending is just an integer multiply per channel
+void DrawGlyph(Rect rect, CachedGlyph* glyph, int stride, Rect limits)
+{
+    Assert(rect.left <= rect.right);
+    Assert(rect.bottom <= rect.top);
+
+    //TODO: There shouldn't be -1s at the end of these things, fix
+    if (!limits.right) limits.right = drawTarget->width - 1;
+    if (!limits.top) limits.top = drawTarget->height - 1;
+    limits = IntersectRects(limits, Rect {drawRegion.left, drawRegion.right, drawRegion.bottom - 1, drawRegion.top - 1});
+
+    if (displayList.recording)
+    {
+        DrawCommand command = {DRAW_COMMAND_GLYPH, rect, limits};
+        command.glyphPixels = glyph->pixels;
+        command.stride = stride;
+        RecordDrawCommand(command);
+    }
+    else
+    {
+        RasteriseGlyph(drawTarget, rect, glyph->pixels, stride, limits);
+    }
+}
+
+void DrawBitmap(Rect rect, uint32* pixels, Rect limits)
+{
+    limits = IntersectRects(limits, drawRegion);
+
+    if (displayList.recording)
+    {
+        DrawCommand command = {DRAW_COMMAND_BITMAP, rect, limits};
+        command.pixels = pixels;
+        RecordDrawCommand(command);
+    }
+    else
+    {
+        RasteriseBitmap(drawTarget, rect, pixels, limits);
+    }
+}
+
+internal void BeginDisplayList()
+{
+    displayList.recording = true;
+    displayList.numCommands = 0;
+}
+
+internal void RasteriseBand(void* data)
+{
+    PROFILE_FUNCTION();
+    Rect band = *(Rect*)data;
+    Rect glyphBand = {band.left, band.right, band.bottom - 1, band.top - 1};
+
+    for (int i = 0; i < displayList.numCommands; ++i)
+    {
+        DrawCommand* command = &displayList.commands[i];
+        switch (command->type)
         {
-            uint8* greyScalePixel = pixels + stride * (y + pixelRowStart) + x + pixelColStart;
-            
-            byte scaledR =  (byte)(*greyScalePixel / 255.0f * colour.r);
-            byte scaledB =  (byte)(*greyScalePixel / 255.0f * colour.b);
-            byte scaledG =  (byte)(*greyScalePixel / 255.0f * colour.g);
-            
-            float alphaA = *greyScalePixel / 255.f;
-            float alphaB = 1.f;
-            float drawnAlpha = alphaA + alphaB * (1.f - alphaA);
-            byte pixelB = pixel[0];
-            byte pixelG = pixel[1];
-            byte pixelR = pixel[2];
-            byte drawnR = (byte)((scaledR*alphaA + pixelR*alphaB*(1 - alphaA)) / drawnAlpha);
-            byte drawnG = (byte)((scaledG*alphaA + pixelG*alphaB*(1 - alphaA)) / drawnAlpha);
-            byte drawnB = (byte)((scaledB*alphaA + pixelB*alphaB*(1 - alphaA)) / drawnAlpha);
-            
-            *pixel = drawnB;
-            pixel++;
-            *pixel = drawnG;
-            pixel++;
-            *pixel = drawnR;
-            pixel++;
-            *pixel = 0;
-            pixel++;
+            case DRAW_COMMAND_RECT:
+                RasteriseRect(&screenBuffer, command->rect, command->colour, IntersectRects(command->limits, band));
+                break;
+            case DRAW_COMMAND_ALPHA_RECT:
+                RasteriseAlphaRect(&screenBuffer, command->rect, command->alphaColour, 
+                                   IntersectRects(command->limits, band));
+                break;
+            case DRAW_COMMAND_GLYPH:
+                RasteriseGlyph(&screenBuffer, command->rect, command->glyphPixels, command->stride, 
+                               IntersectRects(command->limits, glyphBand));
+                break;
+            case DRAW_COMMAND_BITMAP:
+                RasteriseBitmap(&screenBuffer, command->rect, command->pixels, IntersectRects(command->limits, band));
+                break;
         }
-		row -= screenBuffer.width * PIXEL_IN_BYTES;
     }
 }
 
-void DrawText(string text, int xCoord, int yCoord, Colour colour, Rect limits)
-{ 
+//Everything recorded is inside bounds, which is split into bands of rows for the worker threads
+internal void EndDisplayList(Rect bounds)
+{
+    displayList.recording = false;
+    if (RectIsEmpty(bounds) || displayList.numCommands == 0) return;
+
+    local_persist Rect bands[MAX_DRAW_BANDS];
+    JobCounter bandCounter = {};
+
+    int rows = bounds.top - bounds.bottom;
+    int area = rows * (bounds.right - bounds.left);
+    int maxBands = min(MAX_DRAW_BANDS, 2 * (GetNumWorkerThreads() + 1)); //Extra bands even out uneven text
+    int numBands = Clamp(area / MIN_DRAW_BAND_PIXELS, 1, min(maxBands, rows));
+
+    if (numBands == 1)
+    {
+        RasteriseBand(&bounds);
+        return;
+    }
+
+    for (int i = 0; i < numBands; ++i)
+    {
+        bands[i] = bounds;
+        bands[i].bottom = bounds.bottom + rows * i / numBands;
+        bands[i].top = bounds.bottom + rows * (i + 1) / numBands;
+        AddWork(RasteriseBand, &bands[i], &bandCounter);
+    }
+    WaitForCounter(&bandCounter);
+}
+
+//Every glyph is drawn once in the colour of the run it's in, text past the last run isn't drawn
+void DrawColouredText(string text, ColourRun* runs, int numRuns, int xCoord, int yCoord, Rect limits)
+{
+    PROFILE_FUNCTION();
 	int xAdvance = 0;
-    for (int i = 0; i < text.len; i++)
+    int i = 0;
+    int runEnd = 0;
+    for (int r = 0; r < numRuns; ++r)
     {
-        FontChar fc = fontData.chars[text[i]];
-        int xOffset = fc.left + xAdvance + xCoord;
-        int yOffset = yCoord - (fc.height + fc.top);
-        Rect charDims = {xOffset, (int)(xOffset + fc.width), yOffset, (int)(yOffset + fc.height)};
+        //A char split between runs is drawn in the colour of the run it starts in
+        runEnd = min(runEnd + runs[r].len, text.len);
+        while (i < runEnd)
+        {
+            int charLen;
+            uint32 codepoint = DecodeUTF8(text, i, &charLen);
+            FontChar fc = *GetFontChar(codepoint);
+            int xOffset = fc.left + xAdvance + xCoord;
+            int yOffset = yCoord - (fc.height + fc.top);
+            Rect charDims = {xOffset, (int)(xOffset + fc.width), yOffset, (int)(yOffset + fc.height)};
 
-        Draw8bppPixels(charDims, (byte*)fc.pixels, fc.width, colour, limits);
+            DrawGlyph(charDims, GetCachedGlyph(codepoint, runs[r].colour), fc.width, limits);
 
-		xAdvance += fc.advance;
+		    xAdvance += fc.advance;
+            i += charLen;
+        }
     }
 }
 
+void DrawText(string text, int xCoord, int yCoord, Colour colour, Rect limits)
+{ 
+    ColourRun run = {text.len, colour};
+    DrawColouredText(text, &run, 1, xCoord, yCoord, limits);
+}
+
 //
 //EDITOR HELPER FUNCTIONS
 //
@@ -461,6 +780,7 @@ Editor InitEditor(string fileName = lstring(""))
 
 void SetTopChangedLine(Editor* editor, int newLineIndex)
 {
+    editor->numChanges++;
     if (editor->topChangedLineIndex != -1)
         editor->topChangedLineIndex = min(editor->topChangedLineIndex, newLineIndex);
     else 
@@ -501,6 +821,7 @@ void RemoveTextSection(Editor* editor, TextSectionInfo sectionInfo)
     }
 
     //Shift lines below highlited section up
+    MarkLinesChanged(editor, sectionInfo.top.line, editor->numLines);
     editor->numLines -= sectionInfo.bottom.line - sectionInfo.top.line;
     for (int i = sectionInfo.top.line + 1; i < editor->numLines; ++i)
     {
@@ -617,6 +938,7 @@ void InsertLineAt(Editor* editor, int lineIndex)
         editor->lines[i] = editor->lines[i-1];
     }
 	editor->lines[lineIndex] = init_string_buf(LINE_CHUNK_SIZE, lineMemoryAllocator);
+    MarkLinesChanged(editor, lineIndex, editor->numLines);
 }
 
 void InsertText(Editor* editor, string multilineText, EditorPos insertAt)
@@ -662,12 +984,82 @@ void InsertText(Editor* editor, string multilineText, EditorPos insertAt)
         editor->lines[insertAt.line].len -= remainderText.len;
     }
 
+    MarkLinesChanged(editor, insertAt.line, lineIndex + 1);
     SetTopChangedLine(editor, insertAt.line);
 }
 
+struct SaveWork
+{
+    Editor* editor;
+    string_buf fileName;
+    string_buf text;
+    bool overwrite;
+    int writeStart;
+    uint32 numChanges; //The editor's when the text was copied
+};
+
+global SaveWork saveWork;
+global JobCounter saveCounter;
+
+internal void PrintSaveErrorWork(void* data)
+{
+    char* message = (char*)data;
+    Print(message);
+    free(message);
+}
+
+//The editor is only marked as saved once the file has really been written, and only if it hasn't been
+//edited again whilst it was being written
+internal void FinishSaveWork(void* data)
+{
+    SaveWork* work = (SaveWork*)data;
+    Editor* editor = work->editor;
+    if (!work->overwrite) editor->fileName = work->fileName.toStr();
+    if (editor->numChanges == work->numChanges)
+    {
+        editor->topChangedLineIndex = -1;
+        OnFileSave((int)(editor - editors));
+    }
+
+    work->fileName.dealloc();
+}
+
+//Writing the file doesn't need the editor, so it's done as a job with copies of the text and name
+internal void WriteSaveWork(void* data)
+{
+    PROFILE_FUNCTION();
+    SaveWork* work = (SaveWork*)data;
+    if (WriteToFile(work->fileName.toStr(), work->text.toStr(), work->overwrite, work->writeStart))
+    {
+        AddMainThreadWork(FinishSaveWork, work);
+    }
+    else
+    {
+        int messageLen = work->fileName.len + 32;
+        char* message = HeapAlloc(char, messageLen);
+        snprintf(message, messageLen, "Couldn't save %.*s\n", work->fileName.len, work->fileName.str);
+        AddMainThreadWork(PrintSaveErrorWork, message);
+        work->fileName.dealloc();
+    }
+
+    work->text.dealloc();
+}
+
+void FinishBackgroundWork()
+{
+    WaitForCounter(&saveCounter);
+    RunMainThreadWork();
+}
+
 //TODO: There is still a bug where 2 null characters are being written (my guess we overshooting /r/n): fix
 void SaveFile(Editor* editor, string fileName)
 {
+    PROFILE_FUNCTION();
+
+    //Only one save is written at a time, so saves to the same file land in order. The last one's 
+    //completion has to have run too, it may have marked the editor as saved or changed its file name.
+    FinishBackgroundWork();
+
     if (editor->topChangedLineIndex == -1) return; 
 
 	bool overwrite = fileName == editor->fileName.toStr();
@@ -679,19 +1071,13 @@ void SaveFile(Editor* editor, string fileName)
     
     EditorPos writeSectionEnd = {editor->lines[editor->numLines - 1].len, editor->numLines - 1};
     TextSectionInfo writeTextSection = GetTextSectionInfo(editor->lines, writeSectionStart, writeSectionEnd);
-    string_buf textToWrite = GetMultilineText(editor, writeTextSection, allocator_temporaryStringArena, true);
-    if(WriteToFile(fileName, textToWrite.toStr(), overwrite, writeStart))
-    {
-        if (!overwrite) editor->fileName = fileName;
-    }
-    else
-    {
-        //Log
-    }
-
-    editor->topChangedLineIndex = -1;
-
-    OnFileSave();
+    saveWork.editor = editor;
+    saveWork.text = GetMultilineText(editor, writeTextSection, Allocator{}, true);
+    saveWork.fileName = init_string_buf(fileName);
+    saveWork.overwrite = overwrite;
+    saveWork.writeStart = writeStart;
+    saveWork.numChanges = editor->numChanges;
+    AddBackgroundWork(WriteSaveWork, &saveWork, &saveCounter);
 }
 
 //TODO: Double check memory leaks
@@ -765,6 +1151,7 @@ void HandleUndoInfo(Editor* editor, UndoInfo undoInfo, bool isRedo)
                 editor->lines[at.line] += remainderText;
                 editor->lines[sectionInfo.top.line].len -= remainderText.len;
             }
+            MarkLinesChanged(editor, sectionInfo.top.line, at.line + 1);
         } break;
 
         case UNDOTYPE_OVERWRITE:
@@ -812,6 +1199,7 @@ void HandleUndoInfo(Editor* editor, UndoInfo undoInfo, bool isRedo)
                     lineIndex++;
                 }
             }
+            MarkLinesChanged(editor, sectionInfo.top.line, lineIndex);
         } break;
 
         //TODO: This assumes that multine cursors are all at the same text index on each line, make this handle different test indicies
@@ -835,6 +1223,7 @@ void HandleUndoInfo(Editor* editor, UndoInfo undoInfo, bool isRedo)
                     lineIndex++;
                 }
             }
+            MarkLinesChanged(editor, sectionInfo.top.line, lineIndex);
         } break;
     }
      
@@ -855,14 +1244,7 @@ EditorPos GetEditorPosAtMouse()
     int mouseLine = lineY / (fontData.maxHeight + fontData.lineGap);
     result.line = min(mouseLine, editor->numLines - 1);
     
-    int linePixLen = GetCurrentEditorTextStart().x;
-    result.textAt = 0;
-    string_buf line = editor->lines[result.line];
-    while (linePixLen < input.mousePixelPos.x && result.textAt < line.len)
-    {
-        linePixLen += fontData.chars[line[result.textAt]].advance;
-        result.textAt++;
-    }
+    result.textAt = LineXToColumn(editor, result.line, input.mousePixelPos.x - GetCurrentEditorTextStart().x);
 
     return result;
 }
@@ -892,21 +1274,9 @@ void HighlightWordAt(Editor* editor, EditorPos pos)
 
 Token GetTokenAtCursor(EditorPos cursorPos)
 {
-    for (int i = 0; i < tokenInfos[openEditorIndexes[currentEditorSide]].numTokens; ++i)
-    {
-        Token token = tokenInfos[openEditorIndexes[currentEditorSide]].tokens[i]; 
-
-        if (token.at.line > cursorPos.line) break;
-
-        if (token.at.line == cursorPos.line)
-        {
-            int tokenEnd = token.at.textAt + token.text.len;
-            if (InRange(cursorPos.textAt, token.at.textAt, tokenEnd))
-                return tokenInfos[openEditorIndexes[currentEditorSide]].tokens[i];
-        }
-    }
-
-    return Token{EditorPos{-1, -1}, string{0, 0}, TOKEN_UNKNOWN};
+    return GetTokenAtPos(&editors[openEditorIndexes[currentEditorSide]], 
+                         &tokenInfos[openEditorIndexes[currentEditorSide]], 
+                         cursorPos);
 }
 
 //
@@ -1008,6 +1378,7 @@ void AddChar(Editor* editor)
     editor->undoStack[editor->numUndos - 1].end = editor->cursorPos;
     if (addedTwoCharacters) editor->undoStack[editor->numUndos - 1].end.textAt++;
 
+    MarkLinesChanged(editor, editor->cursorPos.line, editor->cursorPos.line + 1);
     SetTopChangedLine(editor, editor->cursorPos.line);
 }
 
@@ -1031,6 +1402,7 @@ void RemoveChar(Editor* editor)
         editor->cursorPos.textAt--; 
         *undoReverseBuffer += (*line)[editor->cursorPos.textAt];
 		StringBuf_RemoveAt(line, editor->cursorPos.textAt);
+        MarkLinesChanged(editor, editor->cursorPos.line, editor->cursorPos.line + 1);
     }
     else if (editor->numLines > 1 && editor->cursorPos.line > 0)
     {
@@ -1039,6 +1411,7 @@ void RemoveChar(Editor* editor)
         editor->cursorPos.textAt = editor->lines[editor->cursorPos.line - 1].len;
         
         editor->lines[editor->cursorPos.line - 1] += editor->lines[editor->cursorPos.line].toStr();
+        MarkLinesChanged(editor, editor->cursorPos.line - 1, editor->numLines);
 
 		//Shift lines up
 		for (int i = editor->cursorPos.line; i < editor->numLines; ++i)
@@ -1111,6 +1484,7 @@ void UnTab(Editor* editor)
         {
             int destIndex = numSpacesAtFront - numRemoved;
             StringBuf_RemoveStringAt(&editor->lines[lineAt], destIndex, numRemoved);
+            MarkLinesChanged(editor, lineAt, lineAt + 1);
 
             editor->undoStack[editor->numUndos - 1].start.textAt = 
                 min(destIndex, editor->undoStack[editor->numUndos - 1].start.textAt);
@@ -1179,12 +1553,16 @@ void Enter(Editor* editor)
     StringBuf_RemoveStringAt(&editor->lines[prevLineIndex], 
                                 editor->cursorPos.textAt, 
                                 copiedLen);
+    MarkLinesChanged(editor, prevLineIndex, prevLineIndex + 1);
 
     editor->cursorPos.textAt = 0;
 
     //TODO: Refactor this is hacky
     if (editor->topChangedLineIndex == -1)
+    {
         editor->topChangedLineIndex = prevLineIndex;
+        editor->numChanges++;
+    }
     else 
         SetTopChangedLine(editor, prevLineIndex);
     
@@ -1229,6 +1607,7 @@ void RemoveCurrentLine(Editor* editor)
     EditorPos undoEnd = {editor->lines[removedLine].len, removedLine};
     AddToUndoStack(editor, undoStart, undoEnd, UNDOTYPE_REMOVED_TEXT_SECTION);
 
+    MarkLinesChanged(editor, removedLine, editor->numLines);
     for (int i = removedLine + 1; i < editor->numLines; ++i)
         editor->lines[i-1] = editor->lines[i];
     
@@ -1355,23 +1734,24 @@ void Redo(Editor* editor)
 
 void ZoomIn()
 {
-    fontData.sizeIndex = min(fontData.sizeIndex + 1, StackArrayLen(fontSizes) - 1); 
-    ResizeFont(fontData.sizeIndex);
+    ResizeFont(min(fontData.sizeIndex + 1, NUM_FONT_SIZES - 1));
 }
 
 void ZoomOut()
 {
-    fontData.sizeIndex = max(fontData.sizeIndex - 1, 0); 
-    ResizeFont(fontData.sizeIndex - 1);
+    ResizeFont(max(fontData.sizeIndex - 1, 0));
 }
 
 //TODO: Resize editor.lines if file too big + maybe return success bool?
 void TE_OpenFile()
 {
+    PROFILE_FUNCTION();
+
     if (numEditors >= 3) return;
 
     //Allocating twice on heap here, don't think it should be massive performance hit but kinda sketchy
     string fileName = ShowFileDialogAndGetFileName(false);
+    WaitForCounter(&saveCounter); //In case it's a file still being saved
     string file = ReadEntireFileAsString(fileName);
     if (file.str)
     {
@@ -1433,49 +1813,985 @@ void SelectPrevEditor()
     OnEditorSwitch();
 }
 
-//
+global ColourRunList lineColourRuns;
+global double highlightSeconds = 0.0; //Spent in GetLineColourRuns this frame, for the stats overlay
+global bool timeHighlighting = false; //Only when the overlay or the profiler will look at it
+
+//Draws a line in its syntax colours, or all in the default text colour if the file isn't tokenised
+internal void DrawEditorLine(Editor* editor, TokenInfo* tokenInfo, bool syntaxHighlighted, int lineIndex, 
+                             int x, int y, Rect limits)
+{
+    string_buf line = editor->lines[lineIndex];
+
+    //Only the chars whose glyphs can reach into the limits are drawn, so a line costs at most a screen's width
+    int left = max(limits.left, drawRegion.left);
+    int right = min(limits.right ? limits.right : drawTarget->width, drawRegion.right);
+    LineAdvances* advances = GetLineAdvances(editor, lineIndex);
+    int start = AdvancesXToColumn(advances, left - x - fontData.maxGlyphRight);
+    int end = AdvancesXToColumn(advances, right - x - fontData.minGlyphLeft);
+    if (start >= end) return;
+
+    string visibleText = SubStringAt(line.toStr(), start, end - start);
+    int visibleX = x + advances->prefix[start];
+    if (syntaxHighlighted && lineIndex < tokenInfo->numLines)
+    {
+        if (timeHighlighting)
+        {
+            double highlightStart = GetSeconds();
+            GetLineColourRuns(line, tokenInfo, lineIndex, start, end, &lineColourRuns);
+            highlightSeconds += GetSeconds() - highlightStart;
+        }
+        else
+        {
+            GetLineColourRuns(line, tokenInfo, lineIndex, start, end, &lineColourRuns);
+        }
+        DrawColouredText(visibleText, lineColourRuns.runs, lineColourRuns.numRuns, visibleX, y, limits);
+    }
+    else
+    {
+        DrawText(visibleText, visibleX, y, userSettings.defaultTextColour, limits);
+    }
+}
+
+//
+//LINE CACHE
+//
+
+#define LINE_CACHE_SIZE 1024
+#define LINE_CACHE_BUCKET_BITS 10
+#define LINE_CACHE_BUDGET (64 * MEGABYTE)
+
+//Everything that decides what a rasterised line looks like
+struct LineCacheKey
+{
+    uint64 contentHash;
+    uint64 colourRunHash;
+    int fontSizeIndex;
+    int width;   //Of the pane's text area
+    int xOffset; //The editor's horizontal scroll
+};
+
+inline bool operator==(LineCacheKey lhs, LineCacheKey rhs)
+{
+    return lhs.contentHash == rhs.contentHash && lhs.colourRunHash == rhs.colourRunHash && 
+           lhs.fontSizeIndex == rhs.fontSizeIndex && lhs.width == rhs.width && lhs.xOffset == rhs.xOffset;
+}
+
+//A line's text drawn over the background, covering the same rows as the line background does
+struct CachedLine
+{
+    LineCacheKey key;
+    uint32* pixels; //nullptr if this slot is free
+    int width, height;
+    int next;       //Index + 1 of the next line in the same bucket, 0 if last
+    uint64 lastUsed;
+};
+
+global CachedLine lineCache[LINE_CACHE_SIZE];
+global int lineCacheBuckets[1 << LINE_CACHE_BUCKET_BITS]; //Index + 1 of the first line in each bucket, 0 if empty
+global int numCachedLines = 0;
+global size_t lineCacheBytes = 0;
+global uint64 lineCacheClock = 0;
+//Lines used since this are in the display list, so they can't be evicted until it has been drawn
+global uint64 lineCacheFrameStart = 0;
+
+//Lines of the current editor that a highlight is drawn under
+global int firstHighlightedLine = -1;
+global int lastHighlightedLine = -1;
+
+inline uint32 LineCacheBucket(LineCacheKey key)
+{
+    uint64 hash = key.contentHash ^ (key.colourRunHash * HASH_PRIME64_2);
+    hash ^= (uint64)key.fontSizeIndex | ((uint64)key.width << 8) | ((uint64)(uint32)key.xOffset << 32);
+    hash *= HASH_PRIME64_1;
+    return (uint32)(hash >> (64 - LINE_CACHE_BUCKET_BITS));
+}
+
+internal void RemoveLineFromBucket(int index)
+{
+    CachedLine* cachedLine = &lineCache[index];
+    int* link = &lineCacheBuckets[LineCacheBucket(cachedLine->key)];
+    while (*link != index + 1) 
+        link = &lineCache[*link - 1].next;
+    *link = cachedLine->next;
+}
+
+//Returns false if every line is being used by this frame
+internal bool EvictLeastRecentlyUsedLine()
+{
+    int index = -1;
+    for (int i = 0; i < LINE_CACHE_SIZE; ++i)
+    {
+        if (lineCache[i].pixels && (index == -1 || lineCache[i].lastUsed < lineCache[index].lastUsed)) 
+            index = i;
+    }
+    if (index == -1 || lineCache[index].lastUsed > lineCacheFrameStart) return false;
+
+    CachedLine* cachedLine = &lineCache[index];
+    RemoveLineFromBucket(index);
+    lineCacheBytes -= cachedLine->width * cachedLine->height * PIXEL_IN_BYTES;
+    free(cachedLine->pixels);
+    cachedLine->pixels = nullptr;
+    numCachedLines--;
+    return true;
+}
+
+void ClearLineCache()
+{
+    for (int i = 0; i < LINE_CACHE_SIZE; ++i)
+    {
+        free(lineCache[i].pixels);
+        lineCache[i].pixels = nullptr;
+    }
+
+    numCachedLines = 0;
+    lineCacheBytes = 0;
+    memset(lineCacheBuckets, 0, sizeof(lineCacheBuckets));
+}
+
+inline bool LineFitsInCache(int width, int height)
+{
+    return width > 0 && (size_t)width * height * PIXEL_IN_BYTES <= LINE_CACHE_BUDGET;
+}
+
+//Only hashes the line if it or its tokens have changed since the last time, see MarkLinesChanged and
+//InvalidateLineHashes
+internal LineHashes* GetLineHashes(Editor* editor, TokenInfo* tokenInfo, int lineIndex)
+{
+    LineHashes* result = &editor->lineHashes[lineIndex];
+    if (result->stale)
+    {
+        string_buf line = editor->lines[lineIndex];
+        result->text = HashBytes(line.str, line.len);
+        result->tokenColours = (lineIndex < tokenInfo->numLines) ? HashLineTokenColours(tokenInfo, lineIndex, 0) : 0;
+        result->stale = false;
+    }
+    return result;
+}
+
+//The token colours a line is drawn with, the default colour and background are in here too so changing
+//them in the config doesn't need the cache to be cleared
+internal uint64 HashColourRuns(LineHashes* lineHashes, bool syntaxHighlighted)
+{
+    Colour baseColours[] = {userSettings.backgroundColour, userSettings.defaultTextColour};
+    uint64 hash = HashBytes(baseColours, sizeof(baseColours));
+
+    if (syntaxHighlighted)
+        hash = HashBytes(&lineHashes->tokenColours, sizeof(lineHashes->tokenColours), hash);
+
+    return hash;
+}
+
+//Draws the line the same way it would be on the screen, with the baseline offsetBelowBaseline up from
+//the bottom of the bitmap
+internal void RasteriseLine(CachedLine* cachedLine, Editor* editor, TokenInfo* tokenInfo, bool syntaxHighlighted, 
+                            int lineIndex)
+{
+    ScreenBuffer lineBuffer = {cachedLine->pixels, cachedLine->width, cachedLine->height};
+    ScreenBuffer* prevDrawTarget = drawTarget;
+    Rect prevDrawRegion = drawRegion;
+    bool prevRecording = displayList.recording;
+    drawTarget = &lineBuffer;
+    drawRegion = {0, lineBuffer.width, 0, lineBuffer.height};
+    displayList.recording = false;
+
+    //Glyphs go right up to the edges (glyph limits are one row higher), they're clipped when blitted
+    Rect limits = {0, lineBuffer.width, -1, lineBuffer.height - 1};
+    int x = -cachedLine->key.xOffset;
+    int y = (int)fontData.offsetBelowBaseline;
+
+    DrawRect(drawRegion, userSettings.backgroundColour);
+    DrawEditorLine(editor, tokenInfo, syntaxHighlighted, lineIndex, x, y, limits);
+
+    drawTarget = prevDrawTarget;
+    drawRegion = prevDrawRegion;
+    displayList.recording = prevRecording;
+}
+
+//Returns nullptr if the line couldn't be cached, that only happens when the budget is too small for a frame
+internal CachedLine* GetCachedLine(int editorIndex, int lineIndex, int width)
+{
+    lineCacheClock++;
+
+    Editor* editor = &editors[editorIndex];
+    TokenInfo* tokenInfo = &tokenInfos[editorIndex];
+    bool syntaxHighlighted = IsTokenisable(editor->fileName.toStr());
+    LineHashes* lineHashes = GetLineHashes(editor, tokenInfo, lineIndex);
+
+    LineCacheKey key;
+    key.contentHash = lineHashes->text;
+    key.colourRunHash = HashColourRuns(lineHashes, syntaxHighlighted);
+    key.fontSizeIndex = fontData.sizeIndex;
+    key.width = width;
+    key.xOffset = editor->textOffset.x;
+
+    uint32 bucket = LineCacheBucket(key);
+    for (int i = lineCacheBuckets[bucket]; i; i = lineCache[i - 1].next)
+    {
+        CachedLine* cachedLine = &lineCache[i - 1];
+        if (cachedLine->key == key)
+        {
+            cachedLine->lastUsed = lineCacheClock;
+            return cachedLine;
+        }
+    }
+
+    int height = (int)(fontData.maxHeight + fontData.lineGap);
+    size_t bytes = width * height * PIXEL_IN_BYTES;
+    while (numCachedLines == LINE_CACHE_SIZE || lineCacheBytes + bytes > LINE_CACHE_BUDGET)
+    {
+        if (!EvictLeastRecentlyUsedLine()) return nullptr;
+    }
+
+    int index = 0;
+    while (lineCache[index].pixels) index++;
+
+    CachedLine* cachedLine = &lineCache[index];
+    cachedLine->key = key;
+    cachedLine->width = width;
+    cachedLine->height = height;
+    cachedLine->pixels = HeapAlloc(uint32, width * height);
+    cachedLine->lastUsed = lineCacheClock;
+    RasteriseLine(cachedLine, editor, tokenInfo, syntaxHighlighted, lineIndex);
+
+    cachedLine->next = lineCacheBuckets[bucket];
+    lineCacheBuckets[bucket] = index + 1;
+    numCachedLines++;
+    lineCacheBytes += bytes;
+
+    return cachedLine;
+}
+
+//Glyph limits are (bottom, top] rather than [bottom, top), so that's what is copied to match them
+internal void BlitCachedLine(CachedLine* cachedLine, int left, int bottom, Rect glyphLimits)
+{
+    Rect lineRect = {left, left + cachedLine->width, bottom, bottom + cachedLine->height};
+    Rect limits = {glyphLimits.left, glyphLimits.right, glyphLimits.bottom + 1, glyphLimits.top + 1};
+    DrawBitmap(lineRect, cachedLine->pixels, limits);
+}
+
+//
+//STATS OVERLAY
+//
+
+#define MAX_PENDING_LATENCIES 64
+#define STATS_OVERLAY_MARGIN 8
+#define NUM_STATS_PERCENTILES 3
+#define NUM_FRAME_STATS 3 //The last frame, then the average and worst over FRAME_STATS_SECONDS
+#define FRAME_STATS_SECONDS 1.0
+
+//A press that's been handled but isn't on screen yet, the rest of its stages are filled in by FramePresented
+struct PendingLatency
+{
+    double eventTime;
+    double dispatch, edit, tokenise;
+};
+
+struct StatsOverlay
+{
+    bool shown = false;
+    bool stale = false; //There are numbers that weren't there when it was last drawn
+    Rect rect; //Empty when it's hidden
+    float latencies[NUM_LATENCY_STAGES][NUM_STATS_PERCENTILES]; //In ms
+    uint32 numPresses;
+    float frameTimes[NUM_FRAME_STAGES][NUM_FRAME_STATS]; //In ms
+    int numTokens;
+    uint32 lineMemoryUsed, undoMemoryUsed; //In bytes
+};
+
+global float statsPercentiles[NUM_STATS_PERCENTILES] = {0.5f, 0.95f, 0.99f};
+
+global LatencyStats latencyStats;
+global PendingLatency pendingLatencies[MAX_PENDING_LATENCIES];
+global int numPendingLatencies = 0;
+global double frameInputEnd = 0.0; //When all of this frame's input had been handled
+global double frameDrawEnd = 0.0;
+global double tokeniseSeconds = 0.0; //Added to by TextChanged, reset before each input is handled
+
+//Only frames that redrew some of the editor are kept, the ones that just update the overlay would
+//push them out and keep asking for more frames
+global FrameRecords frameRecords;
+global FrameRecord frameRecord; //The frame being drawn
+global double frameStart = 0.0;
+global bool frameRedrewEditor = false;
+
+global StatsOverlay statsOverlay;
+
+//The tokeniser is timed from here so it doesn't have to know about the stats
+internal void TextChanged()
+{
+    double start = GetSeconds();
+    OnTextChanged();
+    double seconds = GetSeconds() - start;
+    tokeniseSeconds += seconds;
+    frameRecord.stages[FRAME_TOKENISE] += (float)seconds;
+}
+
+void FramePresented()
+{
+    bool recordFrame = statsOverlay.shown && frameRedrewEditor;
+    if (numPendingLatencies == 0 && !recordFrame) return;
+
+    double presentTime = GetSeconds();
+    for (int i = 0; i < numPendingLatencies; ++i)
+    {
+        PendingLatency* pending = &pendingLatencies[i];
+        AddToHistogram(&latencyStats.stages[LATENCY_DISPATCH], pending->dispatch);
+        AddToHistogram(&latencyStats.stages[LATENCY_EDIT], pending->edit);
+        AddToHistogram(&latencyStats.stages[LATENCY_TOKENISE], pending->tokenise);
+        AddToHistogram(&latencyStats.stages[LATENCY_DRAW], frameDrawEnd - frameInputEnd);
+        AddToHistogram(&latencyStats.stages[LATENCY_PRESENT], presentTime - frameDrawEnd);
+        AddToHistogram(&latencyStats.stages[LATENCY_TOTAL], presentTime - pending->eventTime);
+    }
+    numPendingLatencies = 0;
+
+    if (recordFrame)
+    {
+        frameRecord.endTime = presentTime;
+        frameRecord.stages[FRAME_PRESENT] = (float)(presentTime - frameDrawEnd);
+        frameRecord.stages[FRAME_TOTAL] = (float)(presentTime - frameStart);
+        AddFrameRecord(&frameRecords, &frameRecord);
+    }
+
+    //These numbers are from after the frame was drawn, so it takes another one to show them
+    statsOverlay.stale = statsOverlay.shown;
+}
+
+void ToggleStatsOverlay()
+{
+    statsOverlay.shown = !statsOverlay.shown;
+}
+
+void DumpLatencyStats()
+{
+    char text[1024];
+    int len = snprintf(text, sizeof(text), "Input latency over %u presses (ms)\n%-10s%9s%9s%9s%9s\n",
+                       latencyStats.stages[LATENCY_TOTAL].numSamples, "", "p50", "p95", "p99", "max");
+    for (int i = 0; i < NUM_LATENCY_STAGES; ++i)
+    {
+        Histogram* histogram = &latencyStats.stages[i];
+        len += snprintf(text + len, sizeof(text) - len, "%-10s%9.3f%9.3f%9.3f%9.3f\n",
+                        LatencyStageToStr((LatencyStage)i),
+                        1000.0 * HistogramPercentile(histogram, 0.5f),
+                        1000.0 * HistogramPercentile(histogram, 0.95f),
+                        1000.0 * HistogramPercentile(histogram, 0.99f),
+                        1000.0 * histogram->maxSeconds);
+    }
+    Print(text);
+}
+
+//Works out what the overlay shows and where, before the dirty rects are found
+internal void LayoutStatsOverlay()
+{
+    statsOverlay.stale = false;
+    if (!statsOverlay.shown)
+    {
+        statsOverlay.rect = {};
+        return;
+    }
+
+    for (int i = 0; i < NUM_LATENCY_STAGES; ++i)
+    {
+        for (int p = 0; p < NUM_STATS_PERCENTILES; ++p)
+            statsOverlay.latencies[i][p] = (float)(1000.0 * HistogramPercentile(&latencyStats.stages[i], statsPercentiles[p]));
+    }
+    statsOverlay.numPresses = latencyStats.stages[LATENCY_TOTAL].numSamples;
+
+    float averages[NUM_FRAME_STAGES], maxes[NUM_FRAME_STAGES];
+    int numFrames = SummariseFrames(&frameRecords, GetSeconds(), FRAME_STATS_SECONDS, averages, maxes);
+    FrameRecord* lastFrame = (frameRecords.numRecords > 0) ? 
+                             &frameRecords.records[(frameRecords.numRecords - 1) % MAX_FRAME_RECORDS] : nullptr;
+    for (int i = 0; i < NUM_FRAME_STAGES; ++i)
+    {
+        statsOverlay.frameTimes[i][0] = (lastFrame && numFrames > 0) ? 1000.0f * lastFrame->stages[i] : 0.0f;
+        statsOverlay.frameTimes[i][1] = 1000.0f * averages[i];
+        statsOverlay.frameTimes[i][2] = 1000.0f * maxes[i];
+    }
+
+    Editor* editor = &editors[openEditorIndexes[currentEditorSide]];
+    statsOverlay.numTokens = tokenInfos[openEditorIndexes[currentEditorSide]].numTokens;
+    statsOverlay.lineMemoryUsed = lineMemory.numUsedChunks * LINE_CHUNK_SIZE;
+    statsOverlay.undoMemoryUsed = (uint32)editor->undoStringArena.used;
+
+    //Latencies get a header, a row per stage and the number of presses, frame times a header and a row per
+    //stage, then a row each for the tokens and the two arenas
+    int lineHeight = (int)(fontData.maxHeight + fontData.lineGap);
+    int numColumns = max(NUM_STATS_PERCENTILES, NUM_FRAME_STATS);
+    int width = TextPixelLength(cstring("highlight ")) + numColumns * TextPixelLength(cstring(" 0000.00")) +
+                2 * STATS_OVERLAY_MARGIN;
+    int numRows = (NUM_LATENCY_STAGES + 2) + (NUM_FRAME_STAGES + 1) + 3;
+    int height = numRows * lineHeight + 2 * STATS_OVERLAY_MARGIN;
+    statsOverlay.rect = {screenBuffer.width - width, screenBuffer.width, screenBuffer.height - height, screenBuffer.height};
+}
+
+internal void DrawStatsOverlay()
+{
+    Rect rect = statsOverlay.rect;
+    DrawRect(rect, userSettings.lineBackgroundColour);
+
+    int lineHeight = (int)(fontData.maxHeight + fontData.lineGap);
+    int left = rect.left + STATS_OVERLAY_MARGIN;
+    int valuesLeft = left + TextPixelLength(cstring("highlight "));
+    int valueWidth = TextPixelLength(cstring(" 0000.00"));
+    int y = rect.top - STATS_OVERLAY_MARGIN - lineHeight + (int)fontData.offsetBelowBaseline;
+
+    //Values are right aligned in their columns, so they still line up in fonts that aren't monospaced
+    char text[32];
+    DrawText(cstring("ms"), left, y, userSettings.lineNumColour);
+    for (int p = 0; p < NUM_STATS_PERCENTILES; ++p)
+    {
+        snprintf(text, sizeof(text), "p%d", (int)(statsPercentiles[p] * 100.0f));
+        int right = valuesLeft + (p + 1) * valueWidth;
+        DrawText(cstring(text), right - TextPixelLength(cstring(text)), y, userSettings.lineNumColour);
+    }
+    y -= lineHeight;
+
+    for (int i = 0; i < NUM_LATENCY_STAGES; ++i)
+    {
+        DrawText(cstring(LatencyStageToStr((LatencyStage)i)), left, y, userSettings.lineNumColour);
+        for (int p = 0; p < NUM_STATS_PERCENTILES; ++p)
+        {
+            snprintf(text, sizeof(text), "%.2f", statsOverlay.latencies[i][p]);
+            int right = valuesLeft + (p + 1) * valueWidth;
+            DrawText(cstring(text), right - TextPixelLength(cstring(text)), y, userSettings.defaultTextColour);
+        }
+        y -= lineHeight;
+    }
+
+    snprintf(text, sizeof(text), "%u presses", statsOverlay.numPresses);
+    DrawText(cstring(text), left, y, userSettings.lineNumColour);
+    y -= lineHeight;
+
+    char* frameStatNames[NUM_FRAME_STATS] = {"now", "avg", "max"};
+    DrawText(cstring("frame"), left, y, userSettings.lineNumColour);
+    for (int f = 0; f < NUM_FRAME_STATS; ++f)
+    {
+        int right = valuesLeft + (f + 1) * valueWidth;
+        DrawText(cstring(frameStatNames[f]), right - TextPixelLength(cstring(frameStatNames[f])), y, 
+                 userSettings.lineNumColour);
+    }
+    y -= lineHeight;
+
+    for (int i = 0; i < NUM_FRAME_STAGES; ++i)
+    {
+        DrawText(cstring(FrameStageToStr((FrameStage)i)), left, y, userSettings.lineNumColour);
+        for (int f = 0; f < NUM_FRAME_STATS; ++f)
+        {
+            snprintf(text, sizeof(text), "%.2f", statsOverlay.frameTimes[i][f]);
+            int right = valuesLeft + (f + 1) * valueWidth;
+            DrawText(cstring(text), right - TextPixelLength(cstring(text)), y, userSettings.defaultTextColour);
+        }
+        y -= lineHeight;
+    }
+
+    //Counts and sizes go in the last column, they're too long for one
+    int valuesRight = valuesLeft + NUM_FRAME_STATS * valueWidth;
+    char* memoryNames[3] = {"tokens", "lines", "undo"};
+    snprintf(text, sizeof(text), "%d", statsOverlay.numTokens);
+    DrawText(cstring(memoryNames[0]), left, y, userSettings.lineNumColour);
+    DrawText(cstring(text), valuesRight - TextPixelLength(cstring(text)), y, userSettings.defaultTextColour);
+    y -= lineHeight;
+
+    uint32 memoryUsed[2] = {statsOverlay.lineMemoryUsed, statsOverlay.undoMemoryUsed};
+    uint32 memorySizes[2] = {MAX_LINE_MEMORY, MAX_STRING_ARENA_MEMORY};
+    for (int i = 0; i < 2; ++i)
+    {
+        snprintf(text, sizeof(text), "%u / %uKB", memoryUsed[i] / KILOBYTE, memorySizes[i] / KILOBYTE);
+        DrawText(cstring(memoryNames[i + 1]), left, y, userSettings.lineNumColour);
+        DrawText(cstring(text), valuesRight - TextPixelLength(cstring(text)), y, userSettings.defaultTextColour);
+        y -= lineHeight;
+    }
+}
+
+//
+//DIRTY REGIONS
+//
+
+//What a pane looked like last frame, compared against the current frame to find what has to be redrawn
+struct PaneDrawState
+{
+    int editorIndex; //-1 if the pane isn't shown
+    IntPair textOffset;
+    int firstLine, lastLine; //Lines that have an entry in lineHashes
+    uint64 lineHashes[MAX_LINES];
+};
+
+struct DrawState
+{
+    bool screenInvalid = true;
+    int width, height;
+    PaneDrawState panes[2];
+
+    //These move between lines without changing how the lines themselves look, so they're tracked separately
+    Rect lineBackground;
+    Rect cursor;
+
+    Rect statsOverlay;
+    uint64 statsOverlayHash;
+
+    //How far above and below the baseline anything drawn for a line can reach
+    int lineReachAbove, lineReachBelow;
+    //Whether every glyph is inside the rows of the line background, lines can only be cached if so
+    bool glyphsFitInLine;
+};
+
+global DrawState prevDrawState;
+
+//Safe to call mid-frame, nothing is thrown out until the next Draw starts
+void InvalidateLineAdvances()
+{
+    for (int e = 0; e < numEditors; ++e)
+    {
+        for (int i = 0; i < MAX_LINES; ++i)
+            editors[e].lineAdvances[i].stale = true;
+    }
+}
+
+void InvalidateLineHashes(Editor* editor)
+{
+    for (int i = 0; i < MAX_LINES; ++i)
+        editor->lineHashes[i].stale = true;
+}
+
+void InvalidateScreen()
+{
+    prevDrawState.screenInvalid = true;
+}
+
+internal void UpdateLineReach()
+{
+    int lineHeight = (int)(fontData.maxHeight + fontData.lineGap);
+    int lowestRectBottom = min((int)fontData.offsetBelowBaseline, PIXELS_UNDER_BASELINE);
+
+    //Line background, cursor and highlight rects
+    prevDrawState.lineReachAbove = lineHeight - lowestRectBottom;
+    prevDrawState.lineReachBelow = max((int)fontData.offsetBelowBaseline, PIXELS_UNDER_BASELINE);
+
+    //Glyphs, the top row of a glyph is the one at baseline - top. A glyph that reaches further than these
+    //invalidates the screen when it's first rasterised, so this gets called again.
+    prevDrawState.lineReachAbove = max(prevDrawState.lineReachAbove, fontData.glyphReachAbove);
+    prevDrawState.lineReachBelow = max(prevDrawState.lineReachBelow, fontData.glyphReachBelow + 1);
+    prevDrawState.glyphsFitInLine = fontData.glyphReachAbove <= lineHeight - (int)fontData.offsetBelowBaseline &&
+                                    fontData.glyphReachBelow <= (int)fontData.offsetBelowBaseline;
+}
+
+//Cached lines are opaque, so they can't be used where anything else is drawn in the line's rows
+bool LineDrawnFromCache(int editorSide, int lineIndex)
+{
+    if (!prevDrawState.glyphsFitInLine) return false;
+    if (editorSide == currentEditorSide && InRange(lineIndex, firstHighlightedLine, lastHighlightedLine)) return false;
+
+    const int lineHeight = (int)(fontData.maxHeight + fontData.lineGap);
+    Rect textLimits = (editorSide == 0) ? GetLeftTextLimits() : GetRightTextLimits();
+    if (!LineFitsInCache(textLimits.right - textLimits.left, lineHeight)) return false;
+
+    //The line background lags a frame behind scrolling, so it isn't always on the cursor's line
+    Editor* editor = &editors[openEditorIndexes[editorSide]];
+    int y = GetLeftTextStart().y - lineIndex * lineHeight + editor->textOffset.y;
+    Rect lineRect = {textLimits.left, textLimits.right, y - (int)fontData.offsetBelowBaseline, 0};
+    lineRect.top = lineRect.bottom + lineHeight;
+    return !RectsOverlap(lineRect, prevDrawState.lineBackground);
+}
+
+internal Rect GetPaneBounds(int editorSide)
+{
+    int halfWidth = screenBuffer.width / 2;
+    return (editorSide) ? Rect {halfWidth, screenBuffer.width, 0, screenBuffer.height} 
+                        : Rect {0, halfWidth, 0, screenBuffer.height};
+}
+
+//Everything drawn for a line (text, line number, highlight, line background and cursor) is inside these
+internal Rect GetLineBounds(int editorSide, int baselineY)
+{
+    Rect result = GetPaneBounds(editorSide);
+    result.bottom = baselineY - prevDrawState.lineReachBelow;
+    result.top = baselineY + prevDrawState.lineReachAbove;
+    return result;
+}
+
+internal void AddDirtyRect(DirtyRects* dirtyRects, Rect rect)
+{
+    rect = IntersectRects(rect, Rect {0, screenBuffer.width, 0, screenBuffer.height});
+    if (RectIsEmpty(rect)) return;
+
+    //Changed lines in a pane are usually next to each other, so most rects can be merged into one already added
+    for (int i = 0; i < dirtyRects->numRects; ++i)
+    {
+        Rect* other = &dirtyRects->rects[i];
+        bool sameColumnAndTouching = other->left == rect.left && other->right == rect.right &&
+                                     rect.bottom <= other->top && other->bottom <= rect.top;
+        if (sameColumnAndTouching || UnionRects(*other, rect) == *other)
+        {
+            *other = UnionRects(*other, rect);
+            return;
+        }
+    }
+
+    if (dirtyRects->numRects == MAX_DIRTY_RECTS)
+    {
+        //Redrawing a bit more than needed is cheaper than tracking this many separate changes
+        for (int i = 1; i < dirtyRects->numRects; ++i)
+            dirtyRects->rects[0] = UnionRects(dirtyRects->rects[0], dirtyRects->rects[i]);
+        dirtyRects->rects[0] = UnionRects(dirtyRects->rects[0], rect);
+        dirtyRects->numRects = 1;
+        return;
+    }
+
+    dirtyRects->rects[dirtyRects->numRects++] = rect;
+}
+
+//Everything that decides how a line looks apart from where it is, the cursor and the line background
+internal uint64 HashLineAppearance(Editor* editor, TokenInfo* tokenInfo, bool syntaxHighlighted, int lineIndex,
+                                   int highlightStart, int highlightEnd)
+{
+    LineHashes* lineHashes = GetLineHashes(editor, tokenInfo, lineIndex);
+    uint64 hash = lineHashes->text;
+
+    if (syntaxHighlighted)
+        hash = HashBytes(&lineHashes->tokenColours, sizeof(lineHashes->tokenColours), hash);
+
+    int highlight[] = {highlightStart, highlightEnd};
+    hash = HashBytes(highlight, sizeof(highlight), hash);
+
+    return hash | 1; //0 is for lines that weren't drawn
+}
+
+//Compares this frame against the last one and adds the parts of the screen that look different
+internal void FindDirtyRects(DirtyRects* dirtyRects, Editor* currentEditor, Rect lineBackground, Rect cursor)
+{
+    DrawState* prev = &prevDrawState;
+    dirtyRects->numRects = 0;
+
+    bool redrawAll = prev->screenInvalid || prev->width != screenBuffer.width || prev->height != screenBuffer.height;
+    if (redrawAll)
+    {
+        //Whatever made the screen invalid (the font or window changing) makes the cached lines useless too
+        if (prev->screenInvalid) ClearLineCache();
+        AddDirtyRect(dirtyRects, Rect {0, screenBuffer.width, 0, screenBuffer.height});
+        UpdateLineReach();
+        prev->screenInvalid = false;
+        prev->width = screenBuffer.width;
+        prev->height = screenBuffer.height;
+    }
+
+    bool hasHighlight = currentEditor->highlightStart.textAt != -1;
+    TextSectionInfo highlightInfo = {};
+    if (hasHighlight)
+        highlightInfo = GetTextSectionInfo(currentEditor->lines, currentEditor->highlightStart, currentEditor->cursorPos);
+
+    const int lineHeight = (int)(fontData.maxHeight + fontData.lineGap);
+    for (int e = 0; e < 2; ++e)
+    {
+        PaneDrawState* pane = &prev->panes[e];
+        int editorIndex = (e < numEditors) ? openEditorIndexes[e] : -1;
+        Editor* editor = (editorIndex != -1) ? &editors[editorIndex] : nullptr;
+        IntPair textOffset = (editor) ? editor->textOffset : IntPair {};
+
+        bool redrawPane = redrawAll || editorIndex != pane->editorIndex || 
+                          textOffset.x != pane->textOffset.x || textOffset.y != pane->textOffset.y;
+
+        //Highlights aren't limited to the lines with text drawn, a couple either side can poke onto the screen
+        int firstLine = 0;
+        int lastLine = 0;
+        if (editor)
+        {
+            int numLinesOnScreen = screenBuffer.height / lineHeight;
+            int firstLineOnScreen = abs(textOffset.y) / lineHeight;
+            firstLine = max(0, firstLineOnScreen - 2);
+            lastLine = min(editor->numLines, firstLineOnScreen + numLinesOnScreen + 2);
+        }
+
+        bool syntaxHighlighted = editor && IsTokenisable(editor->fileName.toStr());
+        TokenInfo* tokenInfo = (editor) ? &tokenInfos[editorIndex] : nullptr;
+
+        //Lines that were drawn last frame but not this one have to be cleared
+        int compareFrom = (redrawPane) ? firstLine : min(firstLine, pane->firstLine);
+        int compareTo = (redrawPane) ? lastLine : max(lastLine, pane->lastLine);
+        for (int i = compareFrom; i < compareTo; ++i)
+        {
+            uint64 hash = 0;
+            if (i >= firstLine && i < lastLine)
+            {
+                int highlightStart = -1;
+                int highlightEnd = -1;
+                if (hasHighlight && e == currentEditorSide && InRange(i, highlightInfo.top.line, highlightInfo.bottom.line))
+                {
+                    if (i == highlightInfo.top.line)
+                    {
+                        highlightStart = highlightInfo.top.textAt;
+                        highlightEnd = highlightInfo.top.textAt + highlightInfo.topLen;
+                    }
+                    else
+                    {
+                        highlightStart = 0;
+                        highlightEnd = (i == highlightInfo.bottom.line) ? highlightInfo.bottom.textAt : editor->lines[i].len;
+                    }
+                }
+
+                hash = HashLineAppearance(editor, tokenInfo, syntaxHighlighted, i, highlightStart, highlightEnd);
+            }
+
+            bool wasDrawn = i >= pane->firstLine && i < pane->lastLine;
+            uint64 prevHash = (wasDrawn) ? pane->lineHashes[i] : 0;
+            if (!redrawPane && hash != prevHash)
+            {
+                int y = GetLeftTextStart().y - i * lineHeight + textOffset.y;
+                AddDirtyRect(dirtyRects, GetLineBounds(e, y));
+            }
+
+            pane->lineHashes[i] = hash;
+        }
+
+        if (redrawPane) AddDirtyRect(dirtyRects, GetPaneBounds(e));
+
+        pane->editorIndex = editorIndex;
+        pane->textOffset = textOffset;
+        pane->firstLine = firstLine;
+        pane->lastLine = lastLine;
+    }
+
+    if (lineBackground != prev->lineBackground)
+    {
+        AddDirtyRect(dirtyRects, prev->lineBackground);
+        AddDirtyRect(dirtyRects, lineBackground);
+        prev->lineBackground = lineBackground;
+    }
+
+    //An idle editor only ever gets here because the cursor blinked, so only its pixels are redrawn
+    if (cursor != prev->cursor)
+    {
+        AddDirtyRect(dirtyRects, prev->cursor);
+        AddDirtyRect(dirtyRects, cursor);
+        prev->cursor = cursor;
+    }
+
+    //Anything else this frame redraws is part of the editor, the overlay on its own isn't worth recording
+    frameRedrewEditor = dirtyRects->numRects > 0;
+
+    uint64 statsOverlayHash = 0;
+    if (statsOverlay.shown)
+    {
+        statsOverlayHash = HashBytes(statsOverlay.latencies, sizeof(statsOverlay.latencies), statsOverlay.numPresses);
+        statsOverlayHash = HashBytes(statsOverlay.frameTimes, sizeof(statsOverlay.frameTimes), statsOverlayHash);
+        uint32 counts[3] = {(uint32)statsOverlay.numTokens, statsOverlay.lineMemoryUsed, statsOverlay.undoMemoryUsed};
+        statsOverlayHash = HashBytes(counts, sizeof(counts), statsOverlayHash);
+    }
+    if (statsOverlay.rect != prev->statsOverlay || statsOverlayHash != prev->statsOverlayHash)
+    {
+        AddDirtyRect(dirtyRects, prev->statsOverlay);
+        AddDirtyRect(dirtyRects, statsOverlay.rect);
+        prev->statsOverlay = statsOverlay.rect;
+        prev->statsOverlayHash = statsOverlayHash;
+    }
+}
+
+//Draws everything that overlaps region, the rest of the screen is left as it was
+internal void RedrawRegion(Rect region, Editor* currentEditor, Rect lineBackgroundDims, Rect cursorDims)
+{
+    drawRegion = region;
+
+    //Draw Background
+    Rect screenDims = {0, screenBuffer.width, 0, screenBuffer.height};
+    DrawRect(screenDims, userSettings.backgroundColour);
+
+    //Draw Line Background
+    DrawRect(lineBackgroundDims, userSettings.lineBackgroundColour);
+
+    const IntPair textStart = GetCurrentEditorTextStart();
+    const Rect textLimits = GetCurrentEditorTextLimits();
+
+    //Draw highlights
+    if (currentEditor->highlightStart.textAt != -1) 
+    {
+        Assert(currentEditor->highlightStart.line != -1);
+        TextSectionInfo highlightInfo = GetTextSectionInfo(currentEditor->lines, currentEditor->highlightStart, currentEditor->cursorPos);
+        
+        //Draw top line highlight
+		int topXOffset = LineColumnToX(currentEditor, highlightInfo.top.line, highlightInfo.top.textAt);
+        const int topHighlightPixelLength = 
+            LineColumnToX(currentEditor, highlightInfo.top.line, highlightInfo.top.textAt + highlightInfo.topLen) - topXOffset;
+        int topX = textStart.x + topXOffset - currentEditor->textOffset.x;
+        int topY = textStart.y - highlightInfo.top.line * (int)(fontData.maxHeight + fontData.lineGap) 
+                   - PIXELS_UNDER_BASELINE + currentEditor->textOffset.y;
+        if (currentEditor->lines[highlightInfo.top.line].len == 0) topXOffset = fontData.chars[' '].advance;
+        DrawAlphaRect(
+            {topX, topX + topHighlightPixelLength, topY, topY + (int)(fontData.maxHeight + fontData.lineGap)},
+            userSettings.highlightColour, 
+            textLimits
+        );
+
+        //Draw inbetween highlights
+        for (int i = highlightInfo.top.line + 1; i < highlightInfo.bottom.line; ++i)
+        {
+            int x = textStart.x - currentEditor->textOffset.x;
+            int y = textStart.y - i * (int)(fontData.maxHeight + fontData.lineGap) 
+                    - PIXELS_UNDER_BASELINE + currentEditor->textOffset.y;
+
+            //Highlighting the whole file can cover thousands of lines, only measure those that will be drawn
+            if (!RectsOverlap(GetLineBounds(currentEditorSide, y + PIXELS_UNDER_BASELINE), drawRegion)) continue;
+
+            int highlightedPixelLength = LineColumnToX(currentEditor, i, currentEditor->lines[i].len); 
+            if (currentEditor->lines[i].len == 0) highlightedPixelLength = fontData.chars[' '].advance;
+            DrawAlphaRect(
+                {x, x + highlightedPixelLength, y, y + (int)(fontData.maxHeight + fontData.lineGap)}, 
+                userSettings.highlightColour, 
+                textLimits
+            );
+        }
+
+        //Draw bottom line highlight
+        if (!highlightInfo.spansOneLine)
+        {
+            int bottomHighlightPixelLength = 
+                LineColumnToX(currentEditor, highlightInfo.bottom.line, highlightInfo.bottom.textAt);
+            int bottomX = textStart.x - currentEditor->textOffset.x;
+            int bottomY = textStart.y - highlightInfo.bottom.line * (int)(fontData.maxHeight + fontData.lineGap) 
+                          - PIXELS_UNDER_BASELINE + currentEditor->textOffset.y;
+            if (currentEditor->lines[highlightInfo.bottom.line].len == 0) 
+                bottomHighlightPixelLength = fontData.chars[' '].advance;
+            DrawAlphaRect(
+                {
+                    bottomX, bottomX + bottomHighlightPixelLength, 
+                    bottomY, bottomY + (int)(fontData.maxHeight + fontData.lineGap)
+                }, 
+                userSettings.highlightColour, 
+                textLimits
+            );
+        }
+        
+    }
+
+    for (int e = 0; e < min(2, numEditors); ++e)
+    {
+        Editor* editor = &editors[openEditorIndexes[e]]; 
+        
+        const IntPair textStart = (e == 0) ? GetLeftTextStart() : GetRightTextStart();
+        const Rect textLimits = (e == 0) ? GetLeftTextLimits() : GetRightTextLimits();
+
+        TokenInfo* tokenInfo = &tokenInfos[openEditorIndexes[e]];
+        bool syntaxHighlighted = IsTokenisable(editor->fileName.toStr());
+
+        //Draw all of the text on screen
+        int numLinesOnScreen = screenBuffer.height / (int)(fontData.maxHeight + fontData.lineGap);
+        int firstLine = abs(editor->textOffset.y) / (int)(fontData.maxHeight + fontData.lineGap);
+        for (int i = firstLine; i < editor->numLines && i < firstLine + numLinesOnScreen; ++i)
+        {
+            int x = textStart.x - editor->textOffset.x;
+            int y = textStart.y - i * (int)(fontData.maxHeight + fontData.lineGap) + editor->textOffset.y;
+            if (!RectsOverlap(GetLineBounds(e, y), drawRegion)) continue;
+
+            //Draw text
+            CachedLine* cachedLine = nullptr;
+            if (LineDrawnFromCache(e, i))
+                cachedLine = GetCachedLine(openEditorIndexes[e], i, textLimits.right - textLimits.left);
+
+            if (cachedLine)
+            {
+                BlitCachedLine(cachedLine, textLimits.left, y - (int)fontData.offsetBelowBaseline, textLimits);
+            }
+            else
+            {
+                DrawEditorLine(editor, tokenInfo, syntaxHighlighted, i, x, y, textLimits);
+            }
+
+            //Draw Line num
+            char lineNumText[8];
+            IntToString(i + 1, lineNumText);
+            DrawText(cstring(lineNumText), 
+                     textStart.x - TextPixelLength(cstring(lineNumText)) - LINE_NUM_OFFSET, 
+                     y, 
+                     userSettings.lineNumColour, 
+                     {0, 0, textLimits.bottom, 0});
+        }
+    }
+    
+    //Draw Cursor
+    DrawRect(cursorDims, userSettings.cursorColour);
+
+    if (statsOverlay.shown) DrawStatsOverlay();
+}
+
+//
 //MAIN LOOP/STUFF
 //
 
-TimedEvent cursorBlink = {0.5f};
-TimedEvent holdChar = {0.5f};
-TimedEvent repeatChar = {0.02f, {true, &AddChar}};
-TimedEvent holdAction = {0.5f};
-TimedEvent repeatAction = {0.02f};
+#define KEY_REPEAT_DELAY 0.5f
+#define KEY_REPEAT_INTERVAL 0.02f
+#define MULTI_CLICK_TIME 0.5f
+
+bool cursorShown = true;
+
+void ToggleCursor()
+{
+    cursorShown = !cursorShown;
+}
+
+//Repeated chars are tokenised as they go in, the last one could otherwise be left until the next edit
+void RepeatChar(Editor* editor)
+{
+    AddChar(editor);
+    TextChanged();
+}
 
 //TODO: Move multiclicks of this into input
 int numMultiClicks = 0;
 bool doubleClicked = false;
-TimedEvent doubleClick = {0.5f};
 EditorPos prevMousePos = {-1, -1};
 
+void EndMultiClick()
+{
+    numMultiClicks = 0;
+}
+
+Timer cursorBlink = {0.5f, {false, (EditorFunc)ToggleCursor}};
+Timer charRepeat = {KEY_REPEAT_INTERVAL, {true, RepeatChar}};
+Timer actionRepeat = {KEY_REPEAT_INTERVAL}; //Calls whichever non char binding is held
+Timer multiClickTimeout = {0.0f, {false, (EditorFunc)EndMultiClick}};
+
 bool capslockOn = false;
-bool nonCharKeyPressed = false;
 
-//TODO: Generalise all this stuff into a single struct,would be simpler imo
-KeyBinding nonCharKeyBindings[] =
+//The char key that's typing, charRepeat runs whilst it's held. NUM_INPUTS if there isn't one
+InputCode heldCharKey = NUM_INPUTS;
+
+//The key whose binding actionRepeat is repeating, NUM_INPUTS if there isn't one
+InputCode repeatingKey = NUM_INPUTS;
+
+//Whether a key is being held down that repeats, so the cursor is moving even in frames with no input
+internal bool KeyRepeating()
 {
-    //These modify
-    {NONE, INPUTCODE_ENTER, {true, Enter}},
-    {NONE, INPUTCODE_BACKSPACE, {true, Backspace}},
+    return heldCharKey != NUM_INPUTS || (repeatingKey != NUM_INPUTS && InputHeld(input.flags[repeatingKey]));
+}
 
-    //These do not modify
-    {NONE, INPUTCODE_RIGHT, {true, MoveCursorForward}},
-    {NONE, INPUTCODE_LEFT, {true, MoveCursorBackward}},
-    {NONE, INPUTCODE_UP, {true, MoveCursorUp}},
-    {NONE, INPUTCODE_DOWN, {true, MoveCursorDown}}
-};
+void ToggleCapslock()
+{
+    capslockOn = !capslockOn;
+}
 
-KeyBinding commandBindings[] = 
+void ReloadUserSettings()
+{
+    free(userSettings.fontFile.str); //TODO: Get this free outta here once we have more than one string
+    userSettings = LoadUserSettingsFromConfigFile();
+    ChangeFont(userSettings.fontFile);
+}
+
+//Compiled into boundKeys by Init. Bindings for the same key are called in this order.
+KeyBinding keyBindings[] = 
 {
     //These modify
-    {CTRL | SHIFT, INPUTCODE_L, {true, RemoveCurrentLine}},
-    {CTRL, INPUTCODE_V, {true, Paste}},
-    {CTRL, INPUTCODE_X, {true, CutHighlightedText}},
-    {CTRL, INPUTCODE_Y, {true, Redo}},
-    {CTRL, INPUTCODE_Z, {true, Undo}},
+    {ANY, INPUTCODE_ENTER, {true, Enter}, KEYBINDING_MOVES_CURSOR | KEYBINDING_MODIFIES_TEXT},
+    {ANY, INPUTCODE_BACKSPACE, {true, Backspace}, KEYBINDING_MOVES_CURSOR | KEYBINDING_MODIFIES_TEXT},
+    {SHIFT, INPUTCODE_TAB, {true, UnTab}, KEYBINDING_MOVES_CURSOR | KEYBINDING_MODIFIES_TEXT},
+    {CTRL | SHIFT, INPUTCODE_L, {true, RemoveCurrentLine}, KEYBINDING_MODIFIES_TEXT},
+    {CTRL, INPUTCODE_V, {true, Paste}, KEYBINDING_MODIFIES_TEXT},
+    {CTRL, INPUTCODE_X, {true, CutHighlightedText}, KEYBINDING_MODIFIES_TEXT},
+    {CTRL, INPUTCODE_Y, {true, Redo}, KEYBINDING_MODIFIES_TEXT},
+    {CTRL, INPUTCODE_Z, {true, Undo}, KEYBINDING_MODIFIES_TEXT},
 
     //These do not modify
+    {ANY, INPUTCODE_RIGHT, {true, MoveCursorForward}, KEYBINDING_MOVES_CURSOR},
+    {ANY, INPUTCODE_LEFT, {true, MoveCursorBackward}, KEYBINDING_MOVES_CURSOR},
+    {ANY, INPUTCODE_UP, {true, MoveCursorUp}, KEYBINDING_MOVES_CURSOR},
+    {ANY, INPUTCODE_DOWN, {true, MoveCursorDown}, KEYBINDING_MOVES_CURSOR},
     {CTRL, INPUTCODE_A, {true, HighlightEntireFile}},
     {CTRL, INPUTCODE_C, {true, CopyHighlightedText}},
     {CTRL, INPUTCODE_L, {true, HighlightCurrentLine}},
@@ -1489,162 +2805,130 @@ KeyBinding commandBindings[] =
     {ALT,  INPUTCODE_RIGHT, {false, (EditorFunc)SelectNextEditor}},
     {ALT,  INPUTCODE_LEFT,  {false, (EditorFunc)SelectPrevEditor}},
     {CTRL, INPUTCODE_MINUS,  {false, (EditorFunc)ZoomOut}},
-    {CTRL, INPUTCODE_EQUALS, {false, (EditorFunc)ZoomIn}}
+    {CTRL, INPUTCODE_EQUALS, {false, (EditorFunc)ZoomIn}},
+    {ANY,  INPUTCODE_CAPSLOCK, {false, (EditorFunc)ToggleCapslock}},
+    {ANY,  INPUTCODE_F5, {false, (EditorFunc)ReloadUserSettings}},
+    {ANY,  INPUTCODE_F1, {false, (EditorFunc)ToggleStatsOverlay}},
+    {ANY,  INPUTCODE_F2, {false, (EditorFunc)DumpLatencyStats}},
+    {ANY,  INPUTCODE_F3, {false, (EditorFunc)ToggleProfiling}},
+    {ANY,  INPUTCODE_F4, {false, (EditorFunc)DumpProfile}}
 };
 
 void Init()
 {   
+    InitBlitKernels();
     LoadTokenColours();
+    LoadGrammars();
 
     editors[0] = InitEditor();
 
     for (int i = 0; i < 3; ++i)
         tokenInfos[i] = InitTokenInfo();
+
+    StartTimer(&cursorBlink, cursorBlink.interval);
+
+    for (int i = 0; i < (int)StackArrayLen(keyBindings); ++i)
+        BindKey(keyBindings[i].commandKeys, keyBindings[i].mainKey, keyBindings[i].callback, keyBindings[i].flags);
+}
+
+//TODO: Maybe make mouse drag highlight extend from multi click? 
+internal void DragHighlight(Editor* editor)
+{
+    InitHighlight(editor, editor->cursorPos.textAt, editor->cursorPos.line);
+    if (!doubleClicked) editor->cursorPos = GetEditorPosAtMouse();
 }
 
-void Draw(float dt)
+//Handles one press or release, the input flags only ever have the edge for that event's code.
+//Only the key the event is for is looked at. Returns whether the cursor is moving.
+internal bool HandleInput(InputEvent* event)
 {
     Editor* currentEditor = &editors[openEditorIndexes[currentEditorSide]];
 
-    //Detect key input and handle char input
+    //Char keys type unless ctrl is held, shift+tab is left for its binding
     //TODO: look into simultaneous input with backpace and char keys
-    bool charKeyDown = false;
-    bool charKeyPressed = false;
-    bool newCharKeyPressed = false;
-    bool ctrlUp = false; //This seems hacky but whatever
-    for (int code = (int)KEYS_START; code < (int)NUM_INPUTS; ++code)
+    bool typed = false;
+    if (event->type == INPUTEVENT_DOWN && event->code >= CHAR_KEYS_START && !InputHeld(input.leftCtrl))
     {
-        if (code >= (int)CHAR_KEYS_START)
+        char charOfKeyPressed = InputCodeToChar(event->code, InputHeld(input.leftShift), capslockOn);
+        if (charOfKeyPressed != '\t' || !InputHeld(input.leftShift))
         {
-            if (InputDown(input.flags[code]))
-            {
-                char charOfKeyPressed = InputCodeToChar((InputCode)code, 
-                                                        InputHeld(input.leftShift), 
-                                                        capslockOn);
-                
-                //Hacky Fix. Refactor if possible
-                if (charOfKeyPressed == '\t' && InputHeld(input.leftShift)) break;
-
-                currentEditor->currentChar = charOfKeyPressed;
-                if (charOfKeyPressed) AddChar(currentEditor);
-
-                holdAction.elapsedTime = 0.0f;
-
-                charKeyDown = true;
-                if (charKeyPressed)
-                    newCharKeyPressed = true;
-                nonCharKeyPressed = false;
-            }
-            else if (InputHeld(input.flags[code]))
-            {
-                charKeyPressed = true;
-                if (ctrlUp)
-                {
-                    char charOfKeyPressed = InputCodeToChar((InputCode)code, 
-                                                        InputHeld(input.leftShift), 
-                                                        capslockOn);
-				    Assert(charOfKeyPressed != 0);
-                    currentEditor->currentChar = charOfKeyPressed;
-                }
-                if (charKeyDown)
-                    newCharKeyPressed = true;
-            }
-            else if (InputUp(input.flags[code]))
+            currentEditor->currentChar = charOfKeyPressed;
+            if (charOfKeyPressed)
             {
-                newCharKeyPressed = true;
+                AddChar(currentEditor);
+                ClearHighlights(currentEditor); //The char has taken the place of anything highlighted
+                TextChanged();
+                StartTimer(&charRepeat, KEY_REPEAT_DELAY);
+                StopTimer(&actionRepeat);
+                heldCharKey = event->code;
+                typed = true;
             }
         }
-        else if (InputDown(input.flags[code]))
-        {
-            nonCharKeyPressed = true;
-        }
-        else if (code == INPUTCODE_LCTRL)
-        {
-            if (InputUp(input.leftCtrl)) ctrlUp = true;
-            else if (InputHeld(input.leftCtrl)) break;
-        }
-        
     }
-    
-    bool cursorMoving = charKeyPressed || InputHeld(input.backspace) || ArrowKeysHeld(input.arrowKeys);
 
-    if (charKeyPressed && !nonCharKeyPressed && !InputHeld(input.leftCtrl) && 
-        InputHeld(input.flags[CharToInputCode(currentEditor->currentChar)]))
+    //Any other key going down ends the char's repeat, as does it coming up
+    if ((event->type == INPUTEVENT_DOWN && !typed && event->code >= KEYS_START) ||
+        (event->type == INPUTEVENT_UP && event->code == heldCharKey))
     {
-        if (newCharKeyPressed) holdChar.elapsedTime = 0.0f;
-        HandleTimedEvent(&holdChar, dt, &repeatChar, currentEditor);
+        StopTimer(&charRepeat);
+        heldCharKey = NUM_INPUTS;
+    }
 
-        cursorMoving = true;
+    //The char that's just been typed only counts as moving once it's held
+    bool cursorMoving = !typed && KeyRepeating();
 
-        ClearHighlights(currentEditor);
+    //Whilst a char is held RepeatChar does the typing and tokenising, so nothing else needs to be done here
+    if (heldCharKey != NUM_INPUTS && !typed)
+    {
+        StopTimer(&actionRepeat);
 
-        OnTextChanged();
+        cursorMoving = true;
     }
     else
     {
-        holdChar.elapsedTime = 0.0f;
-
-        bool inputHeld = false;
-        for (int i = 0; i < StackArrayLen(nonCharKeyBindings); ++i)
+        //Only the key that went down is looked up, nothing is done for held ones
+        byte commandKeys = GetHeldCommandKeys();
+        if (event->type == INPUTEVENT_DOWN)
         {
-            if (InputDown(input.flags[nonCharKeyBindings[i].mainKey]))
+            BoundKey* boundKey = &boundKeys[commandKeys][event->code];
+            for (int i = 0; i < boundKey->numCallbacks; ++i)
             {
-                repeatAction.onTrigger = nonCharKeyBindings[i].callback;
-                nonCharKeyBindings[i].callback.editorFunc(currentEditor); //TODO: check for both funcs if needed
-                holdAction.elapsedTime = 0.0f;
-                cursorMoving = true;
+                BoundCallback* bound = &boundKey->callbacks[i];
+                if (bound->callback.isEditorFunc)
+                    bound->callback.editorFunc(currentEditor);
+                else
+                    bound->callback.voidFunc();
+
+                if (bound->flags & KEYBINDING_MODIFIES_TEXT)
+                    TextChanged();
 
-                //NOTE: This i < 2 check may get bad in the future
-                if (i < 2 || !InputHeld(input.leftShift))
+                if (bound->flags & KEYBINDING_MOVES_CURSOR)
                 {
-                    OnTextChanged();
-                    ClearHighlights(currentEditor);
+                    if (!(commandKeys & SHIFT)) ClearHighlights(currentEditor);
+
+                    actionRepeat.onTrigger = bound->callback;
+                    StartTimer(&actionRepeat, KEY_REPEAT_DELAY);
+                    repeatingKey = event->code;
+                    cursorMoving = true;
                 }
             }
-            else if (InputHeld(input.flags[nonCharKeyBindings[i].mainKey]))
-            {
-                inputHeld = true;
-                cursorMoving = true;
-            }
-        } 
+        }
 
-        //Handle Shift Tab
-        //TODO: Less repetition
-        if (InputHeld(input.leftShift))
-        {
-            if (InputDown(input.tab))
-            {
-                repeatAction.onTrigger.editorFunc = UnTab;
-                //repeatAction.onTrigger.isEditorFunc = true;
-                UnTab(currentEditor);
-                holdAction.elapsedTime = 0.0f;
+        //Bindings can open and switch editors
+        currentEditor = &editors[openEditorIndexes[currentEditorSide]];
 
-                cursorMoving = true;
-            }
-            else if (InputHeld(input.tab))
-            {
-                inputHeld = true;
-                cursorMoving = true;
-            }   
+        //A held key that was put on hold by typing picks its repeat back up
+        if (repeatingKey != NUM_INPUTS && InputHeld(input.flags[repeatingKey]))
+        {
+            if (!actionRepeat.running) StartTimer(&actionRepeat, KEY_REPEAT_DELAY);
+            cursorMoving = true;
         }
-
-        if (inputHeld)
-            HandleTimedEvent(&holdAction, dt, &repeatAction, currentEditor);
         else
-            holdAction.elapsedTime = 0.0f;
-
-
-        if (InputDown(input.capsLock))
-            capslockOn = !capslockOn;
-
-        if (InputDown(input.f5))
         {
-            free(userSettings.fontFile.str); //TODO: Get this free outta here once we have more than one string
-            userSettings = LoadUserSettingsFromConfigFile();
-            ResizeFont(fontData.sizeIndex); //Rename function perhaps?
+            StopTimer(&actionRepeat);
+            repeatingKey = NUM_INPUTS;
         }
 
-
         if (InputDown(input.leftMouse))
         {
             ClearHighlights(currentEditor);
@@ -1674,59 +2958,90 @@ void Draw(float dt)
                         break;
                 }
                 doubleClicked = true;
-                doubleClick.elapsedTime = 0.0f;
             }
             prevMousePos = GetEditorPosAtMouse(); //I don't think this is 100% correct but it works
-            numMultiClicks += doubleClick.elapsedTime <= doubleClick.interval;
-        }
 
-        //TODO: Maybe make mouse drag highlight extend from multi click? 
-        if (InputHeld(input.leftMouse))
-        {
-            InitHighlight(currentEditor, currentEditor->cursorPos.textAt, currentEditor->cursorPos.line);
-            if (!doubleClicked) currentEditor->cursorPos = GetEditorPosAtMouse();
+            //Each click in a run has to come quicker than the last to keep it going
+            numMultiClicks++;
+            StartTimer(&multiClickTimeout, MULTI_CLICK_TIME / numMultiClicks);
         }
 
+        if (InputHeld(input.leftMouse)) DragHighlight(currentEditor);
+
         if (InputUp(input.leftMouse))
             doubleClicked = false;
+    }
 
+    return cursorMoving;
+}
 
-        if (!inputHeld)
-        {
-            for (int i = 0; i < StackArrayLen(commandBindings); ++i)
-            {
-                if (KeyCommandDown(commandBindings[i]))
-                {
-                    if (commandBindings[i].callback.isEditorFunc)
-                        commandBindings[i].callback.editorFunc(currentEditor);
-                    else
-                        commandBindings[i].callback.voidFunc();
+void Draw(float dt, DirtyRects* dirtyRects)
+{
+    PROFILE_FUNCTION();
 
-                    //TODO: Find a better way than this stupid if check
-                    if (i < 5) OnTextChanged();
+    frameStart = GetSeconds();
+    frameRecord = {};
+    highlightSeconds = 0.0;
+    timeHighlighting = statsOverlay.shown || profilingEnabled;
 
-                    break;
-                }
-            }
+    //Whatever jobs have handed back since the last frame
+    RunMainThreadWork();
+
+    Editor* currentEditor = &editors[openEditorIndexes[currentEditorSide]];
+
+    //Key repeats that were due before a key came up this frame still count
+    RunTimers(dt, currentEditor);
+
+    //Events are handled one at a time in the order they came in, so a key that goes down and up
+    //within a frame still counts and every press sees the modifiers that were held at the time
+    bool cursorMoving = false;
+    bool handledInput = false;
+    bool mouseMoved = false;
+    InputEvent event;
+    while (PopInputEvent(&event))
+    {
+        if (!ApplyInputEvent(&input, &event))
+        {
+            if (event.type == INPUTEVENT_MOUSE_MOVE) mouseMoved = true;
+            continue;
         }
-    }    
 
-    //Only caught this bug when using mouse but putting it here since may save my back in other situations
-    if (currentEditor->highlightStart == currentEditor->cursorPos)
-        ClearHighlights(currentEditor);
+        double handleStart = GetSeconds();
+        tokeniseSeconds = 0.0;
+        cursorMoving |= HandleInput(&event);
+        input.flags[event.code] &= ~(INPUT_DOWN | INPUT_UP);
+        handledInput = true;
+
+        //Only presses are measured, releases hardly ever change what's on screen
+        if (event.type == INPUTEVENT_DOWN && numPendingLatencies < MAX_PENDING_LATENCIES)
+        {
+            PendingLatency* pending = &pendingLatencies[numPendingLatencies++];
+            pending->eventTime = event.time;
+            pending->dispatch = handleStart - event.time;
+            pending->tokenise = tokeniseSeconds;
+            pending->edit = GetSeconds() - handleStart - tokeniseSeconds;
+        }
+    }
 
-    doubleClick.elapsedTime += dt * (numMultiClicks);
-    if (doubleClick.elapsedTime >= doubleClick.interval)
+    //Nothing is dispatched without a press or release, held keys repeat from the timers and moving the
+    //mouse only has to drag the highlight along
+    if (!handledInput)
     {
-        numMultiClicks = 0;
-        doubleClick.elapsedTime = 0.0f;
+        cursorMoving = KeyRepeating();
+        if (mouseMoved && InputHeld(input.leftMouse) && heldCharKey == NUM_INPUTS)
+            DragHighlight(&editors[openEditorIndexes[currentEditorSide]]);
     }
+    frameInputEnd = GetSeconds();
+    frameRecord.stages[FRAME_INPUT] = (float)(frameInputEnd - frameStart) - frameRecord.stages[FRAME_TOKENISE];
 
-    //Draw Background
-    Rect screenDims = {0, screenBuffer.width, 0, screenBuffer.height};
-    DrawRect(screenDims, userSettings.backgroundColour);
+    currentEditor = &editors[openEditorIndexes[currentEditorSide]];
+
+    //Only caught this bug when using mouse but putting it here since may save my back in other situations
+    if (currentEditor->highlightStart == currentEditor->cursorPos)
+        ClearHighlights(currentEditor);
 
     IntPair cursorDrawPos = {};
+    Rect lineBackgroundDims = {};
     
     for (int e = 0; e < min(2, numEditors); ++e)
     {
@@ -1739,8 +3054,7 @@ void Draw(float dt)
         {
             //Get correct position for cursor
             cursorDrawPos = textStart;
-            for (int i = 0; i < editor->cursorPos.textAt; ++i)
-                cursorDrawPos.x += fontData.chars[editor->lines[editor->cursorPos.line][i]].advance;
+            cursorDrawPos.x += LineColumnToX(editor, editor->cursorPos.line, editor->cursorPos.textAt);
             cursorDrawPos.y -= editor->cursorPos.line * (int)(fontData.maxHeight + fontData.lineGap);
             cursorDrawPos.y -= fontData.offsetBelowBaseline;
 
@@ -1753,10 +3067,13 @@ void Draw(float dt)
                 else
                     editor->textOffset.x = 0;
 
-                char cursorChar = editor->lines[editor->cursorPos.line][editor->cursorPos.textAt];
+                string cursorLine = editor->lines[editor->cursorPos.line].toStr();
+                int charLen;
+                uint32 cursorChar = (editor->cursorPos.textAt < cursorLine.len) ? 
+                                    DecodeUTF8(cursorLine, editor->cursorPos.textAt, &charLen) : 0;
                 int xLeftLimit = textStart.x + editor->textOffset.x;
                 if (cursorDrawPos.x < xLeftLimit)
-                    editor->textOffset.x -= fontData.chars[cursorChar].advance;
+                    editor->textOffset.x -= GetFontChar(cursorChar)->advance;
 	            cursorDrawPos.x -= editor->textOffset.x;
 
                 if (cursorDrawPos.y < textLimits.bottom)
@@ -1771,15 +3088,13 @@ void Draw(float dt)
 
             cursorDrawPos.y += editor->textOffset.y;
 
-            //Draw Line Background
-            Rect lineBackgroundDims = 
+            lineBackgroundDims = 
             {
                 textLimits.left, 
                 textLimits.right, 
                 cursorDrawPos.y, 
                 cursorDrawPos.y + (int)(fontData.maxHeight + fontData.lineGap)
             };
-            DrawRect(lineBackgroundDims, userSettings.lineBackgroundColour);
         }
 
         if (e == !MouseOnLeftSide())
@@ -1787,110 +3102,57 @@ void Draw(float dt)
             int delta = (int)(input.scrollWheelDelta * 20.0f);
             editor->textOffset.y = Clamp(editor->textOffset.y - delta, 0, editor->numLines * (int)fontData.maxHeight);
         }
-
-        //Draw all of the text on screen
-        int numLinesOnScreen = screenBuffer.height / (int)(fontData.maxHeight + fontData.lineGap);
-        int firstLine = abs(editor->textOffset.y) / (int)(fontData.maxHeight + fontData.lineGap);
-        for (int i = firstLine; i < editor->numLines && i < firstLine + numLinesOnScreen; ++i)
-        {
-            //Draw text
-            int x = textStart.x - editor->textOffset.x;
-            int y = textStart.y - i * (int)(fontData.maxHeight + fontData.lineGap) + editor->textOffset.y;
-            DrawText(editor->lines[i].toStr(), x, y, userSettings.defaultTextColour, textLimits);
-
-            //Draw Line num
-            char lineNumText[8];
-            IntToString(i + 1, lineNumText);
-            DrawText(cstring(lineNumText), 
-                     textStart.x - TextPixelLength(cstring(lineNumText)) - LINE_NUM_OFFSET, 
-                     y, 
-                     userSettings.lineNumColour, 
-                     {0, 0, textLimits.bottom, 0});
-        }
     }
-    
-    const IntPair textStart = GetCurrentEditorTextStart();
-    const Rect textLimits = GetCurrentEditorTextLimits();
+    input.scrollWheelDelta = 0.0f; //Scroll events add up until they've been used
 
-    //Draw highlights
-    if (currentEditor->highlightStart.textAt != -1) 
+    //The cursor stays shown while it's moving, and starts blinking again once it stops
+    if (cursorMoving)
     {
-        Assert(currentEditor->highlightStart.line != -1);
-        TextSectionInfo highlightInfo = GetTextSectionInfo(currentEditor->lines, currentEditor->highlightStart, currentEditor->cursorPos);
-        
-        //Draw top line highlight
-        char* topHighlightText = 
-            currentEditor->lines[highlightInfo.top.line].str + highlightInfo.top.textAt;
-        const int topHighlightPixelLength = 
-            TextPixelLength(topHighlightText, highlightInfo.topLen);
-		int topXOffset = 
-            TextPixelLength(currentEditor->lines[highlightInfo.top.line].str, highlightInfo.top.textAt);
-        int topX = textStart.x + topXOffset - currentEditor->textOffset.x;
-        int topY = textStart.y - highlightInfo.top.line * (int)(fontData.maxHeight + fontData.lineGap) 
-                   - PIXELS_UNDER_BASELINE + currentEditor->textOffset.y;
-        if (currentEditor->lines[highlightInfo.top.line].len == 0) topXOffset = fontData.chars[' '].advance;
-        DrawAlphaRect(
-            {topX, topX + topHighlightPixelLength, topY, topY + (int)(fontData.maxHeight + fontData.lineGap)},
-            userSettings.highlightColour, 
-            textLimits
-        );
+        cursorShown = true;
+        StartTimer(&cursorBlink, cursorBlink.interval);
+    }
 
-        //Draw inbetween highlights
-        for (int i = highlightInfo.top.line + 1; i < highlightInfo.bottom.line; ++i)
-        {
-            int highlightedPixelLength = TextPixelLength(currentEditor->lines[i].toStr()); 
-            if (currentEditor->lines[i].len == 0) highlightedPixelLength = fontData.chars[' '].advance;
-            int x = textStart.x - currentEditor->textOffset.x;
-            int y = textStart.y - i * (int)(fontData.maxHeight + fontData.lineGap) 
-                    - PIXELS_UNDER_BASELINE + currentEditor->textOffset.y;
-            DrawAlphaRect(
-                {x, x + highlightedPixelLength, y, y + (int)(fontData.maxHeight + fontData.lineGap)}, 
-                userSettings.highlightColour, 
-                textLimits
-            );
-        }
+    Rect cursorDims = {};
+    if (cursorShown)
+    {
+        cursorDims = {cursorDrawPos.x, cursorDrawPos.x + 2, //TODO: Make width scale with font size
+                      cursorDrawPos.y, cursorDrawPos.y + (int)(fontData.maxHeight + fontData.lineGap)};
+    }
 
-        //Draw bottom line highlight
-        if (!highlightInfo.spansOneLine)
-        {
-            int bottomHighlightPixelLength = 
-                TextPixelLength(currentEditor->lines[highlightInfo.bottom.line].str, 
-                                highlightInfo.bottom.textAt);
-            int bottomX = textStart.x - currentEditor->textOffset.x;
-            int bottomY = textStart.y - highlightInfo.bottom.line * (int)(fontData.maxHeight + fontData.lineGap) 
-                          - PIXELS_UNDER_BASELINE + currentEditor->textOffset.y;
-            if (currentEditor->lines[highlightInfo.bottom.line].len == 0) 
-                bottomHighlightPixelLength = fontData.chars[' '].advance;
-            DrawAlphaRect(
-                {
-                    bottomX, bottomX + bottomHighlightPixelLength, 
-                    bottomY, bottomY + (int)(fontData.maxHeight + fontData.lineGap)
-                }, 
-                userSettings.highlightColour, 
-                textLimits
-            );
-        }
-        
+    //Highlight rects sit a little lower than the text, so they can reach into the lines either side
+    firstHighlightedLine = -1;
+    lastHighlightedLine = -1;
+    if (currentEditor->highlightStart.line != -1)
+    {
+        int lineHeight = (int)(fontData.maxHeight + fontData.lineGap);
+        int highlightReach = abs(PIXELS_UNDER_BASELINE - (int)fontData.offsetBelowBaseline) / lineHeight + 1;
+        firstHighlightedLine = min(currentEditor->cursorPos.line, currentEditor->highlightStart.line) - highlightReach;
+        lastHighlightedLine = max(currentEditor->cursorPos.line, currentEditor->highlightStart.line) + highlightReach;
     }
-    
 
+    LayoutStatsOverlay();
+    FindDirtyRects(dirtyRects, currentEditor, lineBackgroundDims, cursorDims);
 
-    cursorBlink.elapsedTime += dt;
-    if (!cursorMoving && cursorBlink.elapsedTime >= cursorBlink.interval)
+    double rasterStart = GetSeconds();
+    Rect dirtyBounds = {};
+    lineCacheFrameStart = lineCacheClock;
+    BeginDisplayList();
+    for (int i = 0; i < dirtyRects->numRects; ++i)
     {
-        holdChar.elapsedTime = 0.0f;
-        if (cursorBlink.elapsedTime >= 2 * cursorBlink.interval) 
-            cursorBlink.elapsedTime = 0.0f;
+        RedrawRegion(dirtyRects->rects[i], currentEditor, lineBackgroundDims, cursorDims);
+        dirtyBounds = (i == 0) ? dirtyRects->rects[i] : UnionRects(dirtyBounds, dirtyRects->rects[i]);
     }
-    else
-    {
-        if (cursorMoving) cursorBlink.elapsedTime = 0.0f;
-        //Draw Cursor
+    EndDisplayList(dirtyBounds);
+    FreeRetiredGlyphs();
 
-        Rect cursorDims = {cursorDrawPos.x, cursorDrawPos.x + 2, //TODO: Make width scale with font size
-                           cursorDrawPos.y, cursorDrawPos.y + (int)(fontData.maxHeight + fontData.lineGap)};
-        DrawRect(cursorDims, userSettings.cursorColour);
-    }
+    frameDrawEnd = GetSeconds();
+    frameRecord.stages[FRAME_HIGHLIGHT] = (float)highlightSeconds;
+    frameRecord.stages[FRAME_RASTER] = (float)(frameDrawEnd - rasterStart - highlightSeconds);
+}
+
+float SecondsUntilNextDraw()
+{
+    if (prevDrawState.screenInvalid || statsOverlay.stale) return 0.0f;
 
-    HighlightSyntax();
+    return SecondsUntilNextTimer();
 }
\ No newline at end of file
@@ -19,6 +19,49 @@ struct Rect
     int left, right, bottom, top;
 };
 
+inline bool operator==(Rect lhs, Rect rhs)
+{
+    return lhs.left == rhs.left && lhs.right == rhs.right && lhs.bottom == rhs.bottom && lhs.top == rhs.top;
+}
+
+inline bool operator!=(Rect lhs, Rect rhs)
+{
+    return !(lhs == rhs);
+}
+
+inline bool RectIsEmpty(Rect rect)
+{
+    return rect.left >= rect.right || rect.bottom >= rect.top;
+}
+
+inline bool RectsOverlap(Rect a, Rect b)
+{
+    return a.left < b.right && b.left < a.right && a.bottom < b.top && b.bottom < a.top;
+}
+
+//Never returns a rect with negative width or height, so the result can be used as drawing limits
+inline Rect IntersectRects(Rect a, Rect b)
+{
+    Rect result = {max(a.left, b.left), min(a.right, b.right), max(a.bottom, b.bottom), min(a.top, b.top)};
+    result.right = max(result.left, result.right);
+    result.top = max(result.bottom, result.top);
+    return result;
+}
+
+inline Rect UnionRects(Rect a, Rect b)
+{
+    return Rect {min(a.left, b.left), max(a.right, b.right), min(a.bottom, b.bottom), max(a.top, b.top)};
+}
+
+#define MAX_DIRTY_RECTS 32
+
+//The parts of the screen buffer that were redrawn in a frame, the platform only has to present these
+struct DirtyRects
+{
+    Rect rects[MAX_DIRTY_RECTS];
+    int numRects;
+};
+
 struct Colour
 {
     byte r, g, b;
@@ -84,6 +127,25 @@ inline bool operator !=(EditorPos lhs, EditorPos rhs)
     return !(lhs == rhs);
 }
 
+//Running totals of the glyph advances along a line, so going between columns and x positions doesn't
+//have to walk the line. Worked out again the first time it's needed after the line is edited or the font changes.
+struct LineAdvances
+{
+    int* prefix = nullptr; //prefix[i] is the pixel length of the first i chars, there are len + 1 of them
+    int len = 0;
+    int size = 0;
+    bool stale = true;
+};
+
+//What drawing compares lines by, so the line cache and dirty rects don't hash every visible line each frame.
+//Worked out again the first time it's needed after the line is edited or the editor is tokenised.
+struct LineHashes
+{
+    uint64 text = 0;
+    uint64 tokenColours = 0; //0 for lines past the end of the tokens
+    bool stale = true;
+};
+
 struct Editor
 {
     string_buf fileName;
@@ -92,6 +154,9 @@ struct Editor
     string_buf lines[MAX_LINES];
     int numLines = 1;
     int topChangedLineIndex = -1;
+    uint32 numChanges = 0; //Goes up with every edit, so a save that finishes later can tell if it's out of date
+    LineAdvances lineAdvances[MAX_LINES]; //One for each of lines, see GetLineAdvances
+    LineHashes lineHashes[MAX_LINES]; //One for each of lines, see GetLineHashes
 
     EditorPos cursorPos = {0};
 
@@ -121,7 +186,17 @@ struct KeyCallback
 };
 
 void Init();
-void Draw(float dt);
+void Draw(float dt, DirtyRects* dirtyRects);
+//How long the platform can wait for input before Draw has to be called again, for timers like the cursor blink.
+//Negative if nothing is due, so it can wait for input forever.
+float SecondsUntilNextDraw();
+void InvalidateScreen(); //Makes the next Draw redraw everything, e.g. after the screen buffer is reallocated
+void InvalidateLineAdvances(); //Makes every line measure its glyphs again, e.g. after the font changes
+void InvalidateLineHashes(Editor* editor); //Makes every line hash its tokens again, e.g. after it's tokenised
+void FinishBackgroundWork(); //Call before exiting, so files still being saved get written
+void FramePresented(); //Call once what the last Draw drew is on screen, so input latency can be measured up to there
+bool PopInputEvent(InputEvent* event); //Gives the platform's input events in the order they came in, false once there are none left
+double GetSeconds(); //High resolution, on the same clock as input event times
 void Print(const char* message);
 
 inline void* dbg_malloc(size_t size, const char* file, int line)
@@ -138,6 +213,13 @@ inline int RoundToInt(float x)
     return (int)x + (frac >= 0.5f);
 }
 
+//Rounded x / 255 without dividing, exact for x <= 255 * 255
+inline uint32 Div255(uint32 x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
 void FreeWin32(void* memory);
 
 void* ReadEntireFile(string fileName, int* fileLen = nullptr);
@@ -147,19 +229,55 @@ inline void* ReadEntireFile(char* fileName, int* fileLen = nullptr)
 }
 string ReadEntireFileAsString(string fileName);
 bool WriteToFile(string fileName, string text, bool overwrite, int32 writeStart = 0);
+bool MakeDirectory(string dirName); //Succeeds if it already exists
 
 void CopyToClipboard(string text);
 string GetClipboardText();
 
 string ShowFileDialogAndGetFileName(bool save);
 
+//Work is split into jobs for the platform's worker threads. Each thread keeps its own jobs and takes the newest
+//first, idle threads steal the oldest from the others, so jobs can add more jobs. A job added with a counter
+//is counted until it finishes, one with a dependency doesn't start until the dependency's count gets to zero.
+//Threads waiting on a counter run jobs in the meantime, apart from background work.
+typedef void (*WorkCallback)(void* data);
+
+struct JobCounter
+{
+    int32 volatile count;
+};
+
+void AddWork(WorkCallback callback, void* data, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+void WaitForCounter(JobCounter* counter);
+//For work nothing in the frame is waiting on, like writing a file. Only the workers run it, after any other
+//jobs, and it's done there and then if there aren't any. Only the main thread adds background work.
+void AddBackgroundWork(WorkCallback callback, void* data, JobCounter* counter = nullptr);
+int GetNumWorkerThreads();
+int GetJobThreadIndex(); //0 on the main thread, the workers count up from 1
+
+//For jobs to hand results back to the editor, run on the main thread at the start of the next Draw
+void AddMainThreadWork(WorkCallback callback, void* data);
+void RunMainThreadWork();
+
+struct ColourRun
+{
+    int len;
+    Colour colour;
+};
+
+struct ColourRunList
+{
+    ColourRun* runs = nullptr;
+    int numRuns = 0;
+    int size = 0;
+};
+
+void DrawColouredText(string text, ColourRun* runs, int numRuns, int xCoord, int yCoord, Rect limits = {0});
 void DrawText(string text, int xCoord, int yCoord, Colour colour, Rect limits = {0});
 
 void OnTextChanged(); //TODO: Expand this to something like an array of function pointers
 void OnFileOpen();
-void OnFileSave();
+void OnFileSave(int editorIndex);
 void OnEditorSwitch();
 
-void HighlightSyntax(); //TODO: Rename to like Draw and then rename other Draw function to Update or something
-
 #endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "TextEditor_defs.h"
 #include "TextEditor_alloc.h"
+#include "TextEditor_profile.h"
 
 StringArena temporaryStringArena;
 StringArena undoStringArena;
@@ -15,6 +16,7 @@ internal inline byte* StringArena_PrevBlock(void* block)
 
 void* StringArena_Alloc(StringArena* arena, size_t size)
 {
+    PROFILE_FUNCTION();
     Assert(arena->used + size + sizeof(byte*) <= MAX_STRING_ARENA_MEMORY);
 
     void* result = arena->top;
@@ -29,6 +31,7 @@ void* StringArena_Alloc(StringArena* arena, size_t size)
 
 void* StringArena_Realloc(StringArena* arena, void* block, size_t size)
 {
+    PROFILE_FUNCTION();
     Assert(block >= arena->memory && block <= arena->memory + MAX_STRING_ARENA_MEMORY);
 
     void* result = StringArena_Alloc(arena, size);
@@ -38,6 +41,7 @@ void* StringArena_Realloc(StringArena* arena, void* block, size_t size)
 
 void StringArena_Free(StringArena* arena, void* block)
 {
+    PROFILE_FUNCTION();
     Assert(block >= arena->memory && block <= arena->memory + MAX_STRING_ARENA_MEMORY);
 
     if (block > arena->top) return;
@@ -62,6 +66,7 @@ void FlushStringArena(StringArena* arena)
 
 void* LineMemory_Alloc(size_t size)
 {
+    PROFILE_FUNCTION();
     Assert(size % LINE_CHUNK_SIZE == 0);
     Assert(size > 0);
 
@@ -141,6 +146,7 @@ internal LineMemoryBlockInfo* LineMemory_GetBlockInfoPtr(void* at)
 
 void* LineMemory_Realloc(void* block, size_t size)
 {
+    PROFILE_FUNCTION();
     void* result = LineMemory_Alloc(size);
 	if (result)
 	{
@@ -155,6 +161,7 @@ void* LineMemory_Realloc(void* block, size_t size)
 
 void LineMemory_Free(void* block)
 {
+    PROFILE_FUNCTION();
     LineMemoryBlockInfo* blockPtr = LineMemory_GetBlockInfoPtr(block);
     const int blockIndex = (int)((blockPtr - lineMemory.blockInfos) / LINE_CHUNK_SIZE);
 
@@ -37,7 +37,7 @@ struct StringArena
 {
     byte memory[MAX_STRING_ARENA_MEMORY];
     byte* top = memory;
-    size_t used = 0; //For debugging only
+    size_t used = 0; //For debugging and the stats overlay
 };
 
 struct LineMemoryBlockInfo
@@ -0,0 +1,366 @@
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "TextEditor_defs.h"
+#include "TextEditor.h"
+#include "TextEditor_blit.h"
+
+//MSVC lets you use any intrinsic anywhere, other compilers need to be told which functions can use AVX2
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+//NOTE: The X byte of the screen buffer is always 0, every kernel writes 0 there
+
+void FillRow_Scalar(uint32* dst, int count, uint32 colour)
+{
+    for (int i = 0; i < count; ++i)
+        dst[i] = colour;
+}
+
+void BlendRow_Scalar(uint32* dst, int count, ColourRGBA colour)
+{
+    uint32 inverseAlpha = 255 - colour.a;
+    uint32 srcB = colour.b * colour.a;
+    uint32 srcG = colour.g * colour.a;
+    uint32 srcR = colour.r * colour.a;
+
+    for (int i = 0; i < count; ++i)
+    {
+        uint32 pixel = dst[i];
+        uint32 drawnB = Div255(srcB + (pixel & 0xFF) * inverseAlpha);
+        uint32 drawnG = Div255(srcG + ((pixel >> 8) & 0xFF) * inverseAlpha);
+        uint32 drawnR = Div255(srcR + ((pixel >> 16) & 0xFF) * inverseAlpha);
+        dst[i] = drawnB | (drawnG << 8) | (drawnR << 16);
+    }
+}
+
+void BlendPremultipliedRow_Scalar(uint32* dst, uint32* src, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        uint32 srcPixel = src[i];
+        uint32 inverseCoverage = srcPixel >> 24;
+
+        if (inverseCoverage == 255) continue;
+        if (inverseCoverage == 0)
+        {
+            dst[i] = srcPixel & 0x00FFFFFF;
+            continue;
+        }
+
+        uint32 pixel = dst[i];
+        uint32 drawnB = (srcPixel & 0xFF)         + Div255((pixel & 0xFF) * inverseCoverage);
+        uint32 drawnG = ((srcPixel >> 8) & 0xFF)  + Div255(((pixel >> 8) & 0xFF) * inverseCoverage);
+        uint32 drawnR = ((srcPixel >> 16) & 0xFF) + Div255(((pixel >> 16) & 0xFF) * inverseCoverage);
+        dst[i] = drawnB | (drawnG << 8) | (drawnR << 16);
+    }
+}
+
+//
+//SSE2
+//
+
+//Same as Div255 on each 16 bit lane, x must already have the 128 added to it
+inline __m128i Div255_SSE2(__m128i x)
+{
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+internal void FillRow_SSE2(uint32* dst, int count, uint32 colour)
+{
+    __m128i colour4 = _mm_set1_epi32((int)colour);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i*)(dst + i), colour4);
+
+    FillRow_Scalar(dst + i, count - i, colour);
+}
+
+internal void BlendRow_SSE2(uint32* dst, int count, ColourRGBA colour)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i colourMask = _mm_set1_epi32(0x00FFFFFF);
+    __m128i inverseAlpha = _mm_set1_epi16((short)(255 - colour.a));
+    __m128i src = _mm_setr_epi16((short)(colour.b * colour.a + 128), (short)(colour.g * colour.a + 128),
+                                 (short)(colour.r * colour.a + 128), 128,
+                                 (short)(colour.b * colour.a + 128), (short)(colour.g * colour.a + 128),
+                                 (short)(colour.r * colour.a + 128), 128);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((__m128i*)(dst + i));
+        __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+
+        lo = Div255_SSE2(_mm_add_epi16(_mm_mullo_epi16(lo, inverseAlpha), src));
+        hi = Div255_SSE2(_mm_add_epi16(_mm_mullo_epi16(hi, inverseAlpha), src));
+
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_and_si128(_mm_packus_epi16(lo, hi), colourMask));
+    }
+
+    BlendRow_Scalar(dst + i, count - i, colour);
+}
+
+internal void BlendPremultipliedRow_SSE2(uint32* dst, uint32* src, int count)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i colourMask = _mm_set1_epi32(0x00FFFFFF);
+    __m128i half = _mm_set1_epi16(128);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i srcPixels = _mm_loadu_si128((__m128i*)(src + i));
+        __m128i pixels = _mm_loadu_si128((__m128i*)(dst + i));
+
+        //Spread each pixel's inverse coverage across all 4 of its lanes
+        __m128i inverseLo = _mm_unpacklo_epi8(srcPixels, zero);
+        __m128i inverseHi = _mm_unpackhi_epi8(srcPixels, zero);
+        inverseLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(inverseLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        inverseHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(inverseHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+        lo = Div255_SSE2(_mm_add_epi16(_mm_mullo_epi16(lo, inverseLo), half));
+        hi = Div255_SSE2(_mm_add_epi16(_mm_mullo_epi16(hi, inverseHi), half));
+
+        __m128i result = _mm_add_epi8(_mm_packus_epi16(lo, hi), srcPixels);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_and_si128(result, colourMask));
+    }
+
+    BlendPremultipliedRow_Scalar(dst + i, src + i, count - i);
+}
+
+//
+//AVX2
+//
+
+TARGET_AVX2 inline __m256i Div255_AVX2(__m256i x)
+{
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+TARGET_AVX2 internal void FillRow_AVX2(uint32* dst, int count, uint32 colour)
+{
+    __m256i colour8 = _mm256_set1_epi32((int)colour);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_si256((__m256i*)(dst + i), colour8);
+
+    FillRow_SSE2(dst + i, count - i, colour);
+}
+
+TARGET_AVX2 internal void BlendRow_AVX2(uint32* dst, int count, ColourRGBA colour)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i colourMask = _mm256_set1_epi32(0x00FFFFFF);
+    __m256i inverseAlpha = _mm256_set1_epi16((short)(255 - colour.a));
+    short srcB = (short)(colour.b * colour.a + 128);
+    short srcG = (short)(colour.g * colour.a + 128);
+    short srcR = (short)(colour.r * colour.a + 128);
+    __m256i src = _mm256_setr_epi16(srcB, srcG, srcR, 128, srcB, srcG, srcR, 128,
+                                    srcB, srcG, srcR, 128, srcB, srcG, srcR, 128);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256((__m256i*)(dst + i));
+        __m256i lo = _mm256_unpacklo_epi8(pixels, zero);
+        __m256i hi = _mm256_unpackhi_epi8(pixels, zero);
+
+        lo = Div255_AVX2(_mm256_add_epi16(_mm256_mullo_epi16(lo, inverseAlpha), src));
+        hi = Div255_AVX2(_mm256_add_epi16(_mm256_mullo_epi16(hi, inverseAlpha), src));
+
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_and_si256(_mm256_packus_epi16(lo, hi), colourMask));
+    }
+
+    BlendRow_SSE2(dst + i, count - i, colour);
+}
+
+TARGET_AVX2 internal void BlendPremultipliedRow_AVX2(uint32* dst, uint32* src, int count)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i colourMask = _mm256_set1_epi32(0x00FFFFFF);
+    __m256i half = _mm256_set1_epi16(128);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i srcPixels = _mm256_loadu_si256((__m256i*)(src + i));
+        __m256i pixels = _mm256_loadu_si256((__m256i*)(dst + i));
+
+        __m256i inverseLo = _mm256_unpacklo_epi8(srcPixels, zero);
+        __m256i inverseHi = _mm256_unpackhi_epi8(srcPixels, zero);
+        inverseLo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(inverseLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        inverseHi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(inverseHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m256i lo = _mm256_unpacklo_epi8(pixels, zero);
+        __m256i hi = _mm256_unpackhi_epi8(pixels, zero);
+        lo = Div255_AVX2(_mm256_add_epi16(_mm256_mullo_epi16(lo, inverseLo), half));
+        hi = Div255_AVX2(_mm256_add_epi16(_mm256_mullo_epi16(hi, inverseHi), half));
+
+        __m256i result = _mm256_add_epi8(_mm256_packus_epi16(lo, hi), srcPixels);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_and_si256(result, colourMask));
+    }
+
+    BlendPremultipliedRow_SSE2(dst + i, src + i, count - i);
+}
+
+internal bool CPUHasAVX2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+
+    //The OS also has to save the AVX registers on context switches
+    __cpuid(info, 1);
+    bool hasOSXSAVE = info[2] & (1 << 27);
+    bool hasAVX = info[2] & (1 << 28);
+    if (!hasOSXSAVE || !hasAVX || (_xgetbv(0) & 0b110) != 0b110) return false;
+
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+void InitBlitKernels()
+{
+    //SSE2 is always there on x64
+    FillRow = FillRow_SSE2;
+    BlendRow = BlendRow_SSE2;
+    BlendPremultipliedRow = BlendPremultipliedRow_SSE2;
+
+    if (CPUHasAVX2())
+    {
+        FillRow = FillRow_AVX2;
+        BlendRow = BlendRow_AVX2;
+        BlendPremultipliedRow = BlendPremultipliedRow_AVX2;
+    }
+}
+
+//
+//SELF TEST
+//
+
+struct BlitKernelSet
+{
+    const char* name;
+    FillRowFunc fillRow;
+    BlendRowFunc blendRow;
+    BlendPremultipliedRowFunc blendPremultipliedRow;
+};
+
+#define BLIT_TEST_MAX_COUNT 40
+#define BLIT_TEST_MAX_OFFSET 8 //Pixels past a 32 byte boundary, covers every alignment of an AVX2 load
+#define BLIT_TEST_BUFFER_SIZE (BLIT_TEST_MAX_OFFSET + BLIT_TEST_MAX_COUNT + 8) //Room after the row to catch overruns
+
+internal uint32 BlitTestRandom(uint32* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+//Compares the whole buffer, so writes before or after the row are caught as well
+internal bool BlitTestCheck(const char* kernelName, const char* setName, int offset, int count, 
+                            uint32* expected, uint32* actual)
+{
+    for (int i = 0; i < BLIT_TEST_BUFFER_SIZE; ++i)
+    {
+        if (expected[i] == actual[i]) continue;
+
+        char message[256];
+        snprintf(message, sizeof(message), "%s_%s doesn't match scalar: offset %d, count %d, pixel %d is %08X not %08X\n",
+                 kernelName, setName, offset, count, i - offset, actual[i], expected[i]);
+        Print(message);
+        return false;
+    }
+    return true;
+}
+
+bool TestBlitKernels()
+{
+    BlitKernelSet sets[] = {
+        {"SSE2", FillRow_SSE2, BlendRow_SSE2, BlendPremultipliedRow_SSE2},
+        {"AVX2", FillRow_AVX2, BlendRow_AVX2, BlendPremultipliedRow_AVX2},
+    };
+    int numSets = (CPUHasAVX2()) ? 2 : 1;
+
+    //The alphas the kernels treat specially plus ones either side of halfway, where rounding goes wrong
+    byte alphas[] = {0, 1, 127, 128, 200, 254, 255};
+
+    alignas(32) uint32 background[BLIT_TEST_BUFFER_SIZE];
+    alignas(32) uint32 src[BLIT_TEST_BUFFER_SIZE];
+    alignas(32) uint32 expected[BLIT_TEST_BUFFER_SIZE];
+    alignas(32) uint32 actual[BLIT_TEST_BUFFER_SIZE];
+
+    uint32 randomState = 0x9E3779B9;
+    int numFailures = 0;
+    for (int s = 0; s < numSets; ++s)
+    {
+        BlitKernelSet* set = &sets[s];
+        for (int offset = 0; offset < BLIT_TEST_MAX_OFFSET; ++offset)
+        {
+            for (int count = 0; count < BLIT_TEST_MAX_COUNT; ++count)
+            {
+                //The X byte of the screen is always 0. src is made the same way as a cached glyph, with runs 
+                //of fully covered and uncovered pixels mixed in since those take their own paths.
+                for (int i = 0; i < BLIT_TEST_BUFFER_SIZE; ++i)
+                {
+                    background[i] = BlitTestRandom(&randomState) & 0x00FFFFFF;
+
+                    uint32 random = BlitTestRandom(&randomState);
+                    uint32 coverage = (random >> 24) % 4 == 0 ? 0 : (random >> 24) % 4 == 1 ? 255 : random & 0xFF;
+                    uint32 b = Div255(coverage * ((random >> 8) & 0xFF) / 255 * coverage);
+                    uint32 g = Div255(coverage * ((random >> 16) & 0xFF) / 255 * coverage);
+                    uint32 r = Div255(coverage * (random & 0xFF) / 255 * coverage);
+                    src[i] = b | (g << 8) | (r << 16) | ((255 - coverage) << 24);
+                }
+
+                uint32 colour = BlitTestRandom(&randomState) & 0x00FFFFFF;
+                memcpy(expected, background, sizeof(background));
+                memcpy(actual, background, sizeof(background));
+                FillRow_Scalar(expected + offset, count, colour);
+                set->fillRow(actual + offset, count, colour);
+                numFailures += !BlitTestCheck("FillRow", set->name, offset, count, expected, actual);
+
+                for (int a = 0; a < (int)StackArrayLen(alphas); ++a)
+                {
+                    uint32 random = BlitTestRandom(&randomState);
+                    ColourRGBA blendColour = {(byte)random, (byte)(random >> 8), (byte)(random >> 16), alphas[a]};
+                    memcpy(expected, background, sizeof(background));
+                    memcpy(actual, background, sizeof(background));
+                    BlendRow_Scalar(expected + offset, count, blendColour);
+                    set->blendRow(actual + offset, count, blendColour);
+                    numFailures += !BlitTestCheck("BlendRow", set->name, offset, count, expected, actual);
+                }
+
+                memcpy(expected, background, sizeof(background));
+                memcpy(actual, background, sizeof(background));
+                BlendPremultipliedRow_Scalar(expected + offset, src + offset, count);
+                set->blendPremultipliedRow(actual + offset, src + offset, count);
+                numFailures += !BlitTestCheck("BlendPremultipliedRow", set->name, offset, count, expected, actual);
+            }
+        }
+    }
+
+    char message[128];
+    snprintf(message, sizeof(message), "Blit kernels: %s checked against scalar, %d failures\n", 
+             (numSets == 2) ? "SSE2 and AVX2" : "SSE2 (no AVX2 on this CPU)", numFailures);
+    Print(message);
+    return numFailures == 0;
+}
@@ -0,0 +1,35 @@
+#include "TextEditor_defs.h"
+#include "TextEditor.h"
+
+#ifndef TEXT_EDITOR_BLIT_H
+#define TEXT_EDITOR_BLIT_H
+
+//Kernels that write a row of 32 bit BGRX pixels into the screen buffer. Every kernel has a scalar
+//version which the SIMD versions must match exactly, InitBlitKernels picks the fastest one the CPU has.
+
+//Writes colour (BGRX) to every pixel
+typedef void (*FillRowFunc)(uint32* dst, int count, uint32 colour);
+//dst = (colour * alpha + dst * (255 - alpha)) / 255
+typedef void (*BlendRowFunc)(uint32* dst, int count, ColourRGBA colour);
+//src is premultiplied BGR with 255 - coverage in the top byte, dst = src + dst * (255 - coverage) / 255
+typedef void (*BlendPremultipliedRowFunc)(uint32* dst, uint32* src, int count);
+
+global FillRowFunc FillRow;
+global BlendRowFunc BlendRow;
+global BlendPremultipliedRowFunc BlendPremultipliedRow;
+
+void FillRow_Scalar(uint32* dst, int count, uint32 colour);
+void BlendRow_Scalar(uint32* dst, int count, ColourRGBA colour);
+void BlendPremultipliedRow_Scalar(uint32* dst, uint32* src, int count);
+
+void InitBlitKernels();
+//Runs every SIMD kernel the CPU has against the scalar one on rows of every length up to 40 at every
+//alignment, printing any that don't match exactly
+bool TestBlitKernels();
+
+inline uint32 PackColour(Colour colour)
+{
+    return (uint32)colour.b | ((uint32)colour.g << 8) | ((uint32)colour.r << 16);
+}
+
+#endif
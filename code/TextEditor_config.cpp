@@ -11,6 +11,7 @@ UserSettings LoadUserSettingsFromConfigFile()
 
     string file = ReadEntireFileAsString(lstring("config/config_general.txt"));
     Assert(file.str);
+    char* startOfFile = file.str;
 
     string line = GetNextLine(&file);
     for (int i = 0; line[0]; ++i)
@@ -91,7 +92,7 @@ UserSettings LoadUserSettingsFromConfigFile()
         line = GetNextLine(&file);
     }
 
-    FreeWin32(file.str);
+    FreeWin32(startOfFile);
 
     return result;
 }
\ No newline at end of file
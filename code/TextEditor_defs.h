@@ -54,6 +54,7 @@ typedef uint8_t byte;
 typedef uint8_t uchar;
 
 typedef uint8_t uint8;
+typedef uint16_t uint16;
 typedef uint32_t uint32;
 typedef uint64_t uint64;
 
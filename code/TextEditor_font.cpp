@@ -4,39 +4,387 @@
 #include "TextEditor_defs.h"
 #include "TextEditor_font.h"
 #include "TextEditor.h"
+#include "TextEditor_dynarray.h"
 
-void ResizeFont(int fontSizeIndex)
+//The font file stays loaded so glyphs can be rasterised whenever they're first needed
+global uchar* ttfFile = nullptr;
+global stbtt_fontinfo fontInfo;
+
+enum FontSizeState
 {
-    stbtt_fontinfo fontInfo;
-    uchar* ttfFile = (uchar*)ReadEntireFile(userSettings.fontFile, 0);
-    stbtt_InitFont(&fontInfo, ttfFile, stbtt_GetFontOffsetForIndex(ttfFile, 0));
+    FONT_SIZE_EMPTY,
+    FONT_SIZE_QUEUED, //Being rasterised by a job
+    FONT_SIZE_READY
+};
+
+//Every size that has been rasterised, fontData is a copy of one of these
+global Font fontSizeSets[NUM_FONT_SIZES];
+global FontSizeState fontSizeStates[NUM_FONT_SIZES];
+global JobCounter fontSizeCounter; //The queued sizes
+
+global GlyphPage* glyphPages[MAX_GLYPH_PAGES]; //nullptr if the slot is free
+global int glyphPageBuckets[1 << GLYPH_PAGE_BUCKET_BITS]; //Index + 1 of the first page in each bucket, 0 if empty
+global int numGlyphPages = 0;
+global size_t glyphPageBytes = 0;
+global uint64 glyphPageClock = 0;
+
+global CachedGlyph glyphCache[GLYPH_CACHE_SIZE];
+global int glyphCacheBuckets[1 << GLYPH_CACHE_BUCKET_BITS]; //Index + 1 of the first glyph in each bucket, 0 if empty
+global int numCachedGlyphs = 0;
+global uint64 glyphCacheClock = 0;
+
+//Pixels of evicted glyphs, the display list may still be drawing them
+global uint32** retiredGlyphPixels = nullptr;
+global int numRetiredGlyphPixels = 0;
+global int retiredGlyphPixelsSize = 0;
+
+internal FontChar RasteriseFontChar(uint32 codepoint, float scale)
+{
+    FontChar fc;
+
+    int width, height, xOffset, yOffset, advance, lsb;
+    fc.pixels = stbtt_GetCodepointBitmap(&fontInfo, 0, scale, codepoint, &width, &height, &xOffset, &yOffset);
+    stbtt_GetCodepointHMetrics(&fontInfo, codepoint, &advance, &lsb);
+
+    fc.width = width;
+    fc.height = height;
+    fc.left = xOffset;
+    fc.top = yOffset;
+    fc.advance = (uint32)RoundToInt(advance * scale);
+    return fc;
+}
+
+//Returns true if the glyph reaches further than any before it
+internal bool GrowGlyphBounds(Font* font, FontChar* fc)
+{
+    int left = (int)fc->left;
+    int right = (int)fc->left + (int)fc->width;
+    int reachAbove = -(int)fc->top + 1;
+    int reachBelow = (int)(fc->height + fc->top) - 1;
+
+    bool grew = left < font->minGlyphLeft || right > font->maxGlyphRight ||
+                reachAbove > font->glyphReachAbove || reachBelow > font->glyphReachBelow;
+
+    font->minGlyphLeft = min(font->minGlyphLeft, left);
+    font->maxGlyphRight = max(font->maxGlyphRight, right);
+    font->glyphReachAbove = max(font->glyphReachAbove, reachAbove);
+    font->glyphReachBelow = max(font->glyphReachBelow, reachBelow);
+    return grew;
+}
 
+//Only touches the font passed in and reads the font file, so it can be run as a job
+internal void RasteriseFontSize(Font* font, int sizeIndex)
+{
     int offsetAboveBaseline, offsetBelowBaseline, lineGap;
     stbtt_GetFontVMetrics(&fontInfo, &offsetAboveBaseline, &offsetBelowBaseline, &lineGap);
-    float scale = stbtt_ScaleForPixelHeight(&fontInfo, 
-                                            (float)PointsToPix(fontSizes[fontData.sizeIndex]));
 
-    fontData.maxHeight = (uint32)RoundToInt((offsetAboveBaseline - offsetBelowBaseline) * scale);
-    fontData.lineGap = (uint32)RoundToInt(lineGap * scale);
-    fontData.offsetBelowBaseline = (uint32)RoundToInt(-offsetBelowBaseline * scale);
+    font->sizeIndex = sizeIndex;
+    font->scale = stbtt_ScaleForPixelHeight(&fontInfo, (float)PointsToPix(fontSizes[sizeIndex]));
+    font->maxHeight = (uint32)RoundToInt((offsetAboveBaseline - offsetBelowBaseline) * font->scale);
+    font->lineGap = (uint32)RoundToInt(lineGap * font->scale);
+    font->offsetBelowBaseline = (uint32)RoundToInt(-offsetBelowBaseline * font->scale);
+
+    //Start from an empty glyph at the pen position
+    font->minGlyphLeft = 0;
+    font->maxGlyphRight = 0;
+    font->glyphReachAbove = 1;
+    font->glyphReachBelow = -1;
 
     for (uchar c = 0; c < 128; ++c)
     {
-        FontChar fc;
+        font->chars[c] = RasteriseFontChar(c, font->scale);
+        GrowGlyphBounds(font, &font->chars[c]);
+    }
+}
+
+internal void RasteriseFontSizeWork(void* data)
+{
+    PROFILE_FUNCTION();
+    Font* font = (Font*)data;
+    RasteriseFontSize(font, (int)(font - fontSizeSets));
+}
+
+//Gets a size ready in the background so switching to it later is instant
+internal void QueueFontSize(int sizeIndex)
+{
+    if (!InRange(sizeIndex, 0, NUM_FONT_SIZES - 1) || fontSizeStates[sizeIndex] != FONT_SIZE_EMPTY) return;
+    //Without worker threads it would be rasterised there and then, holding up the frame
+    if (GetNumWorkerThreads() == 0) return;
+
+    fontSizeStates[sizeIndex] = FONT_SIZE_QUEUED;
+    AddBackgroundWork(RasteriseFontSizeWork, &fontSizeSets[sizeIndex], &fontSizeCounter);
+}
+
+//Nothing reads the queued sizes until all of them are done
+internal void FinishQueuedFontSizes()
+{
+    WaitForCounter(&fontSizeCounter);
+    for (int i = 0; i < NUM_FONT_SIZES; ++i)
+    {
+        if (fontSizeStates[i] == FONT_SIZE_QUEUED) fontSizeStates[i] = FONT_SIZE_READY;
+    }
+}
+
+internal void ClearGlyphPages();
+
+void ResizeFont(int fontSizeIndex)
+{
+    fontSizeIndex = Clamp(fontSizeIndex, 0, NUM_FONT_SIZES - 1);
+
+    //Keep what has been learnt about the current size, like the bounds of glyphs rasterised since switching to it
+    if (fontSizeStates[fontData.sizeIndex] == FONT_SIZE_READY)
+        fontSizeSets[fontData.sizeIndex] = fontData;
+
+    if (fontSizeStates[fontSizeIndex] == FONT_SIZE_QUEUED) 
+    {
+        FinishQueuedFontSizes();
+    }
+    else if (fontSizeStates[fontSizeIndex] == FONT_SIZE_EMPTY)
+    {
+        RasteriseFontSize(&fontSizeSets[fontSizeIndex], fontSizeIndex);
+        fontSizeStates[fontSizeIndex] = FONT_SIZE_READY;
+    }
+
+    fontData = fontSizeSets[fontSizeIndex];
+    QueueFontSize(fontSizeIndex - 1);
+    QueueFontSize(fontSizeIndex + 1);
+
+    InvalidateLineAdvances();
+    InvalidateScreen();
+}
+
+void ChangeFont(string ttfFileName)
+{
+    //Sizes being rasterised in the background are still reading the old file
+    FinishQueuedFontSizes();
+    for (int i = 0; i < NUM_FONT_SIZES; ++i)
+    {
+        if (fontSizeStates[i] != FONT_SIZE_READY) continue;
+        for (int c = 0; c < 128; ++c)
+            stbtt_FreeBitmap(fontSizeSets[i].chars[c].pixels, 0);
+        fontSizeStates[i] = FONT_SIZE_EMPTY;
+    }
+
+    if (ttfFile) FreeWin32(ttfFile);
+    ttfFile = (uchar*)ReadEntireFile(ttfFileName, 0);
+    stbtt_InitFont(&fontInfo, ttfFile, stbtt_GetFontOffsetForIndex(ttfFile, 0));
+
+    //Glyphs of every size are out of date
+    ClearGlyphPages();
+    ClearGlyphCache();
+    ResizeFont(fontData.sizeIndex);
+}
+
+//
+//UNICODE GLYPH PAGES
+//
+
+inline uint32 GlyphPageBucket(uint32 firstCodepoint, int sizeIndex)
+{
+    return ((firstCodepoint / GLYPH_PAGE_SIZE * 31 + sizeIndex) * 2654435761u) >> (32 - GLYPH_PAGE_BUCKET_BITS);
+}
+
+internal void FreeGlyphPage(int index)
+{
+    GlyphPage* page = glyphPages[index];
+    int* link = &glyphPageBuckets[GlyphPageBucket(page->firstCodepoint, page->sizeIndex)];
+    while (*link != index + 1)
+        link = &glyphPages[*link - 1]->next;
+    *link = page->next;
+
+    for (int i = 0; i < GLYPH_PAGE_SIZE; ++i)
+    {
+        if (page->rasterised[i]) stbtt_FreeBitmap(page->chars[i].pixels, 0);
+    }
 
-        stbtt_FreeBitmap(fontData.chars[c].pixels, 0);
-        
-        int width, height, xOffset, yOffset, advance, lsb;
-        fc.pixels = stbtt_GetCodepointBitmap(&fontInfo, 0, scale, c, &width, &height, &xOffset, &yOffset);
-        stbtt_GetCodepointHMetrics(&fontInfo, c, &advance, &lsb);
+    glyphPageBytes -= page->bytes;
+    free(page);
+    glyphPages[index] = nullptr;
+    numGlyphPages--;
+}
 
-        fc.width = width;
-        fc.height = height;
-        fc.left = xOffset;
-        fc.top = yOffset;
-        fc.advance = (uint32)RoundToInt(advance * scale);
-        fontData.chars[c] = fc;
-    } 
+internal void ClearGlyphPages()
+{
+    for (int i = 0; i < MAX_GLYPH_PAGES; ++i)
+    {
+        if (glyphPages[i]) FreeGlyphPage(i);
+    }
+}
+
+internal void EvictLeastRecentlyUsedGlyphPage()
+{
+    int index = -1;
+    for (int i = 0; i < MAX_GLYPH_PAGES; ++i)
+    {
+        if (glyphPages[i] && (index == -1 || glyphPages[i]->lastUsed < glyphPages[index]->lastUsed))
+            index = i;
+    }
+    if (index != -1) FreeGlyphPage(index);
+}
+
+internal GlyphPage* GetGlyphPage(uint32 codepoint)
+{
+    glyphPageClock++;
+
+    uint32 firstCodepoint = codepoint - codepoint % GLYPH_PAGE_SIZE;
+    uint32 bucket = GlyphPageBucket(firstCodepoint, fontData.sizeIndex);
+    for (int i = glyphPageBuckets[bucket]; i; i = glyphPages[i - 1]->next)
+    {
+        GlyphPage* page = glyphPages[i - 1];
+        if (page->firstCodepoint == firstCodepoint && page->sizeIndex == fontData.sizeIndex)
+        {
+            page->lastUsed = glyphPageClock;
+            return page;
+        }
+    }
+
+    //Pages are only read from while their glyph is being drawn, so any of them can be thrown out
+    while (numGlyphPages == MAX_GLYPH_PAGES ||
+           (numGlyphPages > 0 && glyphPageBytes + sizeof(GlyphPage) > GLYPH_PAGE_BUDGET))
+    {
+        EvictLeastRecentlyUsedGlyphPage();
+    }
+
+    int index = 0;
+    while (glyphPages[index]) index++;
+
+    GlyphPage* page = HeapAllocZero(GlyphPage, 1);
+    page->firstCodepoint = firstCodepoint;
+    page->sizeIndex = fontData.sizeIndex;
+    page->bytes = sizeof(GlyphPage);
+    page->lastUsed = glyphPageClock;
+
+    page->next = glyphPageBuckets[bucket];
+    glyphPageBuckets[bucket] = index + 1;
+    glyphPages[index] = page;
+    numGlyphPages++;
+    glyphPageBytes += page->bytes;
+
+    return page;
+}
+
+FontChar* GetUnicodeFontChar(uint32 codepoint)
+{
+    GlyphPage* page = GetGlyphPage(codepoint);
+    FontChar* fc = &page->chars[codepoint % GLYPH_PAGE_SIZE];
+
+    if (!page->rasterised[codepoint % GLYPH_PAGE_SIZE])
+    {
+        *fc = RasteriseFontChar(codepoint, fontData.scale);
+        page->rasterised[codepoint % GLYPH_PAGE_SIZE] = true;
+        page->bytes += fc->width * fc->height;
+        glyphPageBytes += fc->width * fc->height;
+
+        //Lines were measured for redrawing without this glyph, so they need measuring again
+        if (GrowGlyphBounds(&fontData, fc)) InvalidateScreen();
+    }
+
+    return fc;
+}
+
+//
+//GLYPH CACHE
+//
+
+inline uint32 GlyphCacheBucket(uint32 codepoint, int sizeIndex, Colour colour)
+{
+    uint32 hash = ((uint32)colour.r << 16) | ((uint32)colour.g << 8) | colour.b;
+    hash = (hash * 31 + codepoint) * 31 + sizeIndex;
+    return (hash * 2654435761u) >> (32 - GLYPH_CACHE_BUCKET_BITS);
+}
+
+internal void RemoveGlyphFromBucket(int index)
+{
+    CachedGlyph* glyph = &glyphCache[index];
+    int* link = &glyphCacheBuckets[GlyphCacheBucket(glyph->codepoint, glyph->sizeIndex, glyph->colour)];
+    while (*link != index + 1)
+        link = &glyphCache[*link - 1].next;
+    *link = glyph->next;
+}
+
+internal void RetireGlyphPixels(uint32* pixels)
+{
+    if (retiredGlyphPixelsSize == 0)
+    {
+        retiredGlyphPixelsSize = 64;
+        retiredGlyphPixels = HeapAlloc(uint32*, retiredGlyphPixelsSize);
+    }
+    AppendToDynamicArray(retiredGlyphPixels, numRetiredGlyphPixels, pixels, retiredGlyphPixelsSize);
+}
+
+void FreeRetiredGlyphs()
+{
+    for (int i = 0; i < numRetiredGlyphPixels; ++i)
+        free(retiredGlyphPixels[i]);
+    numRetiredGlyphPixels = 0;
+}
+
+//Bakes in the same maths the float blend used to do per pixel, where the colour is scaled by the
+//coverage and then blended by the coverage again
+internal void FillCachedGlyph(CachedGlyph* glyph, FontChar* fc, Colour colour)
+{
+    int numPixels = fc->width * fc->height;
+    glyph->pixels = HeapAlloc(uint32, max(numPixels, 1));
+
+    for (int i = 0; i < numPixels; ++i)
+    {
+        uint32 coverage = fc->pixels[i];
+        uint32 r = Div255(coverage * colour.r / 255 * coverage);
+        uint32 g = Div255(coverage * colour.g / 255 * coverage);
+        uint32 b = Div255(coverage * colour.b / 255 * coverage);
+        glyph->pixels[i] = b | (g << 8) | (r << 16) | ((255 - coverage) << 24);
+    }
+}
+
+CachedGlyph* GetCachedGlyph(uint32 codepoint, Colour colour)
+{
+    glyphCacheClock++;
+
+    uint32 bucket = GlyphCacheBucket(codepoint, fontData.sizeIndex, colour);
+    for (int i = glyphCacheBuckets[bucket]; i; i = glyphCache[i - 1].next)
+    {
+        CachedGlyph* glyph = &glyphCache[i - 1];
+        if (glyph->codepoint == codepoint && glyph->sizeIndex == fontData.sizeIndex && glyph->colour == colour)
+        {
+            glyph->lastUsed = glyphCacheClock;
+            return glyph;
+        }
+    }
+
+    //Use a free slot if there is one, otherwise throw out the least recently used glyph
+    int index = 0;
+    if (numCachedGlyphs < GLYPH_CACHE_SIZE)
+    {
+        index = numCachedGlyphs++;
+    }
+    else
+    {
+        for (int i = 1; i < GLYPH_CACHE_SIZE; ++i)
+        {
+            if (glyphCache[i].lastUsed < glyphCache[index].lastUsed) index = i;
+        }
+        RemoveGlyphFromBucket(index);
+        RetireGlyphPixels(glyphCache[index].pixels);
+    }
+
+    CachedGlyph* glyph = &glyphCache[index];
+    glyph->codepoint = codepoint;
+    glyph->sizeIndex = fontData.sizeIndex;
+    glyph->colour = colour;
+    glyph->lastUsed = glyphCacheClock;
+    FillCachedGlyph(glyph, GetFontChar(codepoint), colour);
+
+    glyph->next = glyphCacheBuckets[bucket];
+    glyphCacheBuckets[bucket] = index + 1;
+
+    return glyph;
+}
+
+void ClearGlyphCache()
+{
+    for (int i = 0; i < numCachedGlyphs; ++i)
+        RetireGlyphPixels(glyphCache[i].pixels);
 
-    FreeWin32(ttfFile);
-}
\ No newline at end of file
+    numCachedGlyphs = 0;
+    memset(glyphCacheBuckets, 0, sizeof(glyphCacheBuckets));
+}
@@ -2,6 +2,7 @@
 #define TEXTEDITOR_FONT_H
 
 #include "TextEditor_defs.h"
+#include "TextEditor.h"
 
 struct FontChar
 {
@@ -16,20 +17,73 @@ struct Font
     string fontName;
     FontChar chars[128];
     int sizeIndex = 3;
+    float scale; //From font units to pixels at this size
     uint32 maxHeight;
     uint32 lineGap;
     uint32 offsetBelowBaseline;
+    //Of every glyph rasterised at this size so far
+    int minGlyphLeft;  //Furthest left of its pen position any glyph starts, can be negative
+    int maxGlyphRight; //Furthest right of its pen position any glyph ends
+    int glyphReachAbove; //Rows above the baseline, 1 - top
+    int glyphReachBelow; //Rows below the baseline, height + top - 1
 };
 
 global const uint32 fontSizes[] = {8, 9, 10, 11, 12, 14, 16, 18, 20, 22, 24, 26, 28, 36, 48, 72};
-global Font fontData;
+#define NUM_FONT_SIZES ((int)StackArrayLen(fontSizes))
+global Font fontData; //A copy of the size being used, see ResizeFont
+
+//Glyphs past ASCII are rasterised the first time they're used, in pages of GLYPH_PAGE_SIZE codepoints
+#define GLYPH_PAGE_SIZE 256
+#define MAX_GLYPH_PAGES 512
+#define GLYPH_PAGE_BUCKET_BITS 9
+#define GLYPH_PAGE_BUDGET (32 * MEGABYTE)
+
+struct GlyphPage
+{
+    uint32 firstCodepoint;
+    int sizeIndex;
+    FontChar chars[GLYPH_PAGE_SIZE];
+    bool rasterised[GLYPH_PAGE_SIZE];
+    size_t bytes;   //Of the page and its glyphs' bitmaps
+    int next;       //Index + 1 of the next page in the same bucket, 0 if last
+    uint64 lastUsed;
+};
+
+#define GLYPH_CACHE_SIZE 2048
+#define GLYPH_CACHE_BUCKET_BITS 12
+
+//A glyph already multiplied by a colour so drawing it doesn't need any float maths
+struct CachedGlyph
+{
+    uint32 codepoint;
+    int sizeIndex;
+    Colour colour;
+
+    uint32* pixels; //Premultiplied BGR with 255 - coverage in the top byte, same layout as FontChar::pixels
+    int next;       //Index + 1 of the next glyph in the same bucket, 0 if last
+    uint64 lastUsed;
+};
 
 inline int PointsToPix(int points)
 {
     return 4 * points / 3;
 }
 
+//Switches to one of fontSizes, sizes that have been used before (or rasterised in the background because a
+//neighbouring size was) don't need anything rasterised
 void ResizeFont(int fontSizeIndex);
+//Loads a TTF file and keeps it resident, throwing out the glyphs of every size
 void ChangeFont(string ttfFileName);
 
+FontChar* GetUnicodeFontChar(uint32 codepoint);
+inline FontChar* GetFontChar(uint32 codepoint)
+{
+    if (codepoint < 128) return &fontData.chars[codepoint];
+    return GetUnicodeFontChar(codepoint);
+}
+
+CachedGlyph* GetCachedGlyph(uint32 codepoint, Colour colour);
+void ClearGlyphCache();
+void FreeRetiredGlyphs(); //Call once nothing drawn this frame still needs the pixels of evicted glyphs
+
 #endif
\ No newline at end of file
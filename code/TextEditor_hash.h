@@ -0,0 +1,111 @@
+#include "string.h"
+
+#include "TextEditor_defs.h"
+
+#ifndef TEXT_EDITOR_HASH_H
+#define TEXT_EDITOR_HASH_H
+
+//64 bit hash in the style of xxHash64, fast enough to hash entire files when checking caches
+
+#define HASH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME64_3 0x165667B19E3779F9ULL
+#define HASH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+inline uint64 RotateLeft64(uint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64 Read64(byte* p)
+{
+    uint64 result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+inline uint32 Read32(byte* p)
+{
+    uint32 result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+inline uint64 HashRound(uint64 acc, uint64 input)
+{
+    acc += input * HASH_PRIME64_2;
+    acc = RotateLeft64(acc, 31);
+    return acc * HASH_PRIME64_1;
+}
+
+inline uint64 HashMergeRound(uint64 acc, uint64 val)
+{
+    acc ^= HashRound(0, val);
+    return acc * HASH_PRIME64_1 + HASH_PRIME64_4;
+}
+
+inline uint64 HashBytes(void* data, size_t len, uint64 seed = 0)
+{
+    byte* p = (byte*)data;
+    byte* end = p + len;
+    uint64 result;
+
+    if (len >= 32)
+    {
+        uint64 v1 = seed + HASH_PRIME64_1 + HASH_PRIME64_2;
+        uint64 v2 = seed + HASH_PRIME64_2;
+        uint64 v3 = seed;
+        uint64 v4 = seed - HASH_PRIME64_1;
+
+        byte* limit = end - 32;
+        do
+        {
+            v1 = HashRound(v1, Read64(p));      p += 8;
+            v2 = HashRound(v2, Read64(p));      p += 8;
+            v3 = HashRound(v3, Read64(p));      p += 8;
+            v4 = HashRound(v4, Read64(p));      p += 8;
+        } while (p <= limit);
+
+        result = RotateLeft64(v1, 1) + RotateLeft64(v2, 7) + RotateLeft64(v3, 12) + RotateLeft64(v4, 18);
+        result = HashMergeRound(result, v1);
+        result = HashMergeRound(result, v2);
+        result = HashMergeRound(result, v3);
+        result = HashMergeRound(result, v4);
+    }
+    else
+    {
+        result = seed + HASH_PRIME64_5;
+    }
+
+    result += (uint64)len;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        result ^= HashRound(0, Read64(p));
+        result = RotateLeft64(result, 27) * HASH_PRIME64_1 + HASH_PRIME64_4;
+    }
+
+    if (p + 4 <= end)
+    {
+        result ^= (uint64)Read32(p) * HASH_PRIME64_1;
+        result = RotateLeft64(result, 23) * HASH_PRIME64_2 + HASH_PRIME64_3;
+        p += 4;
+    }
+
+    for (; p < end; ++p)
+    {
+        result ^= (*p) * HASH_PRIME64_5;
+        result = RotateLeft64(result, 11) * HASH_PRIME64_1;
+    }
+
+    result ^= result >> 33;
+    result *= HASH_PRIME64_2;
+    result ^= result >> 29;
+    result *= HASH_PRIME64_3;
+    result ^= result >> 32;
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,960 @@
+//A platform layer with no window, for running the editor on Linux from scripted input. It draws into a
+//screen buffer like the win32 layer does, times every frame and can dump frames as PPM images, so
+//rendering can be benchmarked and compared against known good frames.
+//
+//Usage: TextEditor_headless [options] <scene file, or recording with -replay> [file to open]
+//       TextEditor_headless -selftest
+//  -font <path>     TTF to use instead of the one in the config
+//  -size <w>x<h>    Screen buffer size, 1280x720 by default
+//  -dt <seconds>    Time each frame is said to take, 1/60 by default so runs are reproducible
+//  -dump <dir>      Write the frames the scene asks for (or every frame with -dumpall) to dir
+//  -dumpall         Dump every frame, not just the ones the scene asks for
+//  -golden <dir>    Compare dumped frames against the ones with the same name in dir, exit with 1 on mismatch
+//  -record <file>   Save the input the editor takes and each frame's dt, to replay the run later
+//  -replay          Feed a recording from -record (or the win32 layer's -record) through Draw instead of
+//                   running a scene. Frames get the dt they were recorded with, so -dt is ignored, and
+//                   -dump writes the last frame.
+//  -profile <file>  Turn profiling on for the whole run and write it to file as Chrome trace JSON
+//  -selftest        Check the SIMD blit kernels give exactly what the scalar ones do instead of running a
+//                   scene, exit with 1 if any don't
+//
+//After the run it prints frame times, memory use and a hash of each open document, so replays of the
+//same recording can be checked against each other. Input latency percentiles go to stderr.
+//
+//A scene is a text file with one command per line, # starts a comment:
+//  down <key>       Press a key and hold it, keys are named the same as InputCodeToStr, e.g. LCTRL, A,
+//  up <key>         OPEN SQ BRACKET
+//  tap <key>        Press and release a key, takes a frame
+//  type <text>      Taps the keys for each character of text, with shift where needed, a frame per char
+//  scroll <lines>   Mouse wheel, positive scrolls up
+//  mouse <x> <y>    Moves the mouse, y is from the top of the screen like window coordinates
+//  wait <frames>    Draws this many frames
+//  dump             Dumps the next frame drawn
+
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <malloc.h>
+
+#include "stdio.h"
+#include "string.h"
+#include "stdlib.h"
+#include "wchar.h"
+#include "math.h"
+
+//windows.h provides these on windows, everything else is plain C
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+
+inline int mbstowcs_s(size_t* converted, wchar_t* dst, size_t dstLen, const char* src, size_t count)
+{
+    size_t result = mbstowcs(dst, src, min(count, dstLen - 1));
+    if (result == (size_t)-1) result = 0;
+    dst[result] = 0;
+    if (converted) *converted = result + 1;
+    return 0;
+}
+
+#include "stb_truetype.h"
+
+#include "TextEditor_defs.h"
+#include "TextEditor_alloc.h"
+#include "TextEditor_string.h"
+#include "TextEditor_input.h"
+#include "TextEditor_font.h"
+#include "TextEditor.h"
+#include "TextEditor_meta.h"
+#include "TextEditor_config.h"
+#include "TextEditor_tokeniser.h"
+#include "TextEditor_blit.h"
+#include "TextEditor_hash.h"
+#include "TextEditor_stats.h"
+#include "TextEditor_profile.h"
+
+#include "TextEditor_alloc.cpp"
+
+DEF_STRING_ARENA_FUNCS(temporaryStringArena);
+
+global Input input = {};
+global ScreenBuffer screenBuffer;
+global UserSettings userSettings;
+
+#include "TextEditor_input.cpp"
+#include "TextEditor.cpp"
+#include "TextEditor_string.cpp"
+#include "TextEditor_font.cpp"
+#include "TextEditor_meta.cpp"
+#include "TextEditor_config.cpp"
+#include "TextEditor_tokeniser.cpp"
+#include "TextEditor_blit.cpp"
+#include "TextEditor_stats.cpp"
+#include "TextEditor_profile.cpp"
+
+#define MAX_JOB_THREADS 64 //Including the main thread
+#define MAX_JOBS_PER_DEQUE 256
+#define MAX_PARKED_JOBS 64
+#define MAX_MAIN_THREAD_WORK 64
+#define MAX_HEADLESS_FRAMES (1 << 20)
+
+struct Job
+{
+    WorkCallback callback;
+    void* data;
+    JobCounter* counter;
+    JobCounter* dependency;
+};
+
+//A Chase-Lev deque, the same as the win32 one
+struct JobDeque
+{
+    int64 volatile top;
+    int64 volatile bottom;
+    Job jobs[MAX_JOBS_PER_DEQUE];
+};
+
+struct MainThreadWorkEntry
+{
+    WorkCallback callback;
+    void* data;
+    int32 volatile ready;
+};
+
+struct JobSystem
+{
+    JobDeque deques[MAX_JOB_THREADS]; //The main thread's is the first
+    JobDeque backgroundDeque; //Only the main thread adds to it and only the workers take from it
+    int numThreads; //Worker threads, not counting the main thread
+    sem_t semaphore;
+
+    //Jobs whose dependency hasn't finished yet
+    int32 volatile parkedLock;
+    Job parked[MAX_PARKED_JOBS];
+    int numParked;
+
+    //Multiple producers, the main thread is the only consumer
+    int64 volatile nextMainThreadWorkToWrite;
+    int64 volatile nextMainThreadWorkToRead;
+    MainThreadWorkEntry mainThreadWork[MAX_MAIN_THREAD_WORK];
+};
+
+global JobSystem jobSystem;
+thread_local int jobThreadIndex = 0;
+
+#define MAX_INPUT_EVENTS 256
+
+//Single producer (the scene), single consumer (the editor's Draw), the same as the win32 one
+struct InputEventQueue
+{
+    uint32 volatile nextEventToWrite;
+    uint32 volatile nextEventToRead;
+    InputEvent events[MAX_INPUT_EVENTS];
+};
+
+global InputEventQueue inputEventQueue;
+
+global InputRecording recording;
+global bool recordingInput = false;
+
+global string fileToOpen = {0};
+global string clipboard = {0};
+
+void Print(const char* message)
+{
+    fputs(message, stderr);
+}
+
+void FreeWin32(void* mem)
+{
+    free(mem);
+}
+
+//Null terminated, lines are read until the first 0
+void* ReadEntireFile(string fileName, int* fileLen)
+{
+    char* fileNameCStr = fileName.cstr();
+    FILE* file = fopen(fileNameCStr, "rb");
+    free(fileNameCStr);
+    if (!file) return nullptr;
+
+    void* result = nullptr;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size >= 0)
+    {
+        result = HeapAlloc(char, size + 1);
+        if (fread(result, 1, size, file) == (size_t)size)
+        {
+            ((char*)result)[size] = 0;
+            if (fileLen) *fileLen = (int)size;
+        }
+        else
+        {
+            free(result);
+            result = nullptr;
+        }
+    }
+
+    fclose(file);
+    return result;
+}
+
+string ReadEntireFileAsString(string fileName)
+{
+    string result;
+    result.str = (char*)ReadEntireFile(fileName, &result.len);
+    return result;
+}
+
+bool WriteToFile(string fileName, string text, bool overwrite, int32 writeStart)
+{
+    Assert(writeStart >= 0);
+
+    char* fileNameCStr = fileName.cstr();
+    FILE* file = fopen(fileNameCStr, (overwrite) ? "r+b" : "wb");
+    free(fileNameCStr);
+    if (!file) return false;
+
+    fseek(file, writeStart, SEEK_SET);
+    bool result = fwrite(text.str, 1, text.len, file) == (size_t)text.len;
+    result = result && ftruncate(fileno(file), writeStart + text.len) == 0;
+    fclose(file);
+
+    return result;
+}
+
+bool MakeDirectory(string dirName)
+{
+    char* dirNameCStr = dirName.cstr();
+    bool result = mkdir(dirNameCStr, 0777) == 0 || errno == EEXIST;
+    free(dirNameCStr);
+
+    return result;
+}
+
+void CopyToClipboard(string text)
+{
+    free(clipboard.str);
+    clipboard.str = HeapAlloc(char, text.len + 1);
+    memcpy(clipboard.str, text.str, text.len);
+    clipboard.str[text.len] = 0;
+    clipboard.len = text.len;
+}
+
+string GetClipboardText()
+{
+    if (!clipboard.str) return {0};
+
+    string result;
+    result.len = clipboard.len;
+    result.str = (char*)Alloc_temporaryStringArena(result.len + 1);
+    memcpy(result.str, clipboard.str, result.len + 1);
+    return result;
+}
+
+//There's no one to ask, so the file given on the command line is opened once and nothing is ever saved
+string ShowFileDialogAndGetFileName(bool save)
+{
+    string result = {0};
+    if (!save)
+    {
+        result = fileToOpen;
+        fileToOpen = {0};
+    }
+
+    input = {0};
+    return result;
+}
+
+internal void headless_PushJob(JobDeque* deque, Job job)
+{
+    int64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    Assert(bottom - __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE) < MAX_JOBS_PER_DEQUE);
+    deque->jobs[bottom % MAX_JOBS_PER_DEQUE] = job;
+
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+    sem_post(&jobSystem.semaphore);
+}
+
+//Only for the thread the deque belongs to, takes the job it added last
+internal bool headless_TakeJob(JobDeque* deque, Job* job)
+{
+    //Thieves have to see bottom go down before top is read, or two threads could get the last job
+    int64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_SEQ_CST);
+    int64 top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+
+    bool result = false;
+    if (top <= bottom)
+    {
+        *job = deque->jobs[bottom % MAX_JOBS_PER_DEQUE];
+        result = true;
+        if (top == bottom)
+        {
+            //The last job, a thief could be taking it as well
+            result = __sync_bool_compare_and_swap(&deque->top, top, top + 1);
+            __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
+    }
+    else
+    {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return result;
+}
+
+//Takes the job that was added first, fails if another thread got to it first
+internal bool headless_StealJob(JobDeque* deque, Job* job)
+{
+    int64 top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+    int64 bottom = __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST);
+    if (top >= bottom) return false;
+
+    *job = deque->jobs[top % MAX_JOBS_PER_DEQUE];
+    return __sync_bool_compare_and_swap(&deque->top, top, top + 1);
+}
+
+inline void headless_LockParkedJobs()
+{
+    while (!__sync_bool_compare_and_swap(&jobSystem.parkedLock, 0, 1))
+        sched_yield();
+}
+
+inline void headless_UnlockParkedJobs()
+{
+    __atomic_store_n(&jobSystem.parkedLock, 0, __ATOMIC_RELEASE);
+}
+
+internal void headless_ReleaseParkedJobs()
+{
+    headless_LockParkedJobs();
+    for (int i = 0; i < jobSystem.numParked;)
+    {
+        if (__atomic_load_n(&jobSystem.parked[i].dependency->count, __ATOMIC_ACQUIRE) == 0)
+        {
+            headless_PushJob(&jobSystem.deques[jobThreadIndex], jobSystem.parked[i]);
+            jobSystem.parked[i] = jobSystem.parked[--jobSystem.numParked];
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    headless_UnlockParkedJobs();
+}
+
+//Returns whether there was a job to run
+internal bool headless_RunNextJob()
+{
+    Job job;
+    bool found = headless_TakeJob(&jobSystem.deques[jobThreadIndex], &job);
+
+    //Each thread starts stealing from the one after it, so they don't all go for the same deque
+    for (int i = 1; !found && i <= jobSystem.numThreads; ++i)
+    {
+        int victim = (jobThreadIndex + i) % (jobSystem.numThreads + 1);
+        found = headless_StealJob(&jobSystem.deques[victim], &job);
+    }
+
+    //Background work is only picked up once there's nothing else, and never by the main thread so it 
+    //can't hold a frame up whilst it waits on its own jobs
+    if (!found && jobThreadIndex != 0)
+        found = headless_StealJob(&jobSystem.backgroundDeque, &job);
+
+    if (found)
+    {
+        job.callback(job.data);
+        if (job.counter && __sync_sub_and_fetch(&job.counter->count, 1) == 0)
+            headless_ReleaseParkedJobs();
+    }
+    return found;
+}
+
+void AddWork(WorkCallback callback, void* data, JobCounter* counter, JobCounter* dependency)
+{
+    Job job = {callback, data, counter, dependency};
+    if (counter) __sync_fetch_and_add(&counter->count, 1);
+
+    //Checked under the lock so the dependency can't finish between being checked and the job being parked
+    if (dependency)
+    {
+        headless_LockParkedJobs();
+        bool parked = __atomic_load_n(&dependency->count, __ATOMIC_ACQUIRE) != 0;
+        if (parked)
+        {
+            Assert(jobSystem.numParked < MAX_PARKED_JOBS);
+            jobSystem.parked[jobSystem.numParked++] = job;
+        }
+        headless_UnlockParkedJobs();
+        if (parked) return;
+    }
+
+    headless_PushJob(&jobSystem.deques[jobThreadIndex], job);
+}
+
+void AddBackgroundWork(WorkCallback callback, void* data, JobCounter* counter)
+{
+    Assert(jobThreadIndex == 0);
+
+    //Nothing would ever take it without workers
+    if (jobSystem.numThreads == 0)
+    {
+        callback(data);
+        return;
+    }
+
+    Job job = {callback, data, counter, nullptr};
+    if (counter) __sync_fetch_and_add(&counter->count, 1);
+    headless_PushJob(&jobSystem.backgroundDeque, job);
+}
+
+void WaitForCounter(JobCounter* counter)
+{
+    while (__atomic_load_n(&counter->count, __ATOMIC_ACQUIRE) != 0)
+    {
+        if (!headless_RunNextJob()) sched_yield();
+    }
+}
+
+int GetNumWorkerThreads()
+{
+    return jobSystem.numThreads;
+}
+
+int GetJobThreadIndex()
+{
+    return jobThreadIndex;
+}
+
+void AddMainThreadWork(WorkCallback callback, void* data)
+{
+    int64 index = __sync_fetch_and_add(&jobSystem.nextMainThreadWorkToWrite, 1);
+    Assert(index - jobSystem.nextMainThreadWorkToRead < MAX_MAIN_THREAD_WORK);
+
+    MainThreadWorkEntry* entry = &jobSystem.mainThreadWork[index % MAX_MAIN_THREAD_WORK];
+    entry->callback = callback;
+    entry->data = data;
+    __atomic_store_n(&entry->ready, 1, __ATOMIC_RELEASE);
+}
+
+void RunMainThreadWork()
+{
+    while (true)
+    {
+        MainThreadWorkEntry* entry = &jobSystem.mainThreadWork[jobSystem.nextMainThreadWorkToRead % MAX_MAIN_THREAD_WORK];
+        if (!__atomic_load_n(&entry->ready, __ATOMIC_ACQUIRE)) break;
+
+        MainThreadWorkEntry work = *entry;
+        __atomic_store_n(&entry->ready, 0, __ATOMIC_RELEASE);
+        jobSystem.nextMainThreadWorkToRead++;
+
+        work.callback(work.data);
+    }
+}
+
+internal void* headless_WorkerThreadProc(void* param)
+{
+    jobThreadIndex = (int)(size_t)param;
+    while (true)
+    {
+        if (!headless_RunNextJob())
+            sem_wait(&jobSystem.semaphore);
+    }
+    return nullptr;
+}
+
+internal void headless_InitJobSystem()
+{
+    //Main thread also does work whilst waiting so leave a core for it
+    jobSystem.numThreads = Clamp((int)sysconf(_SC_NPROCESSORS_ONLN) - 1, 0, MAX_JOB_THREADS - 1);
+    sem_init(&jobSystem.semaphore, 0, 0);
+    for (int i = 1; i <= jobSystem.numThreads; ++i)
+    {
+        pthread_t thread;
+        pthread_create(&thread, 0, headless_WorkerThreadProc, (void*)(size_t)i);
+        pthread_detach(thread);
+    }
+}
+
+double GetSeconds()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+
+//
+//INPUT
+//
+
+internal void headless_PushInputEvent(InputEvent event)
+{
+    uint32 newNextEventToWrite = (inputEventQueue.nextEventToWrite + 1) % MAX_INPUT_EVENTS;
+    Assert(newNextEventToWrite != __atomic_load_n(&inputEventQueue.nextEventToRead, __ATOMIC_ACQUIRE));
+
+    event.time = GetSeconds();
+    inputEventQueue.events[inputEventQueue.nextEventToWrite] = event;
+    __atomic_store_n(&inputEventQueue.nextEventToWrite, newNextEventToWrite, __ATOMIC_RELEASE);
+}
+
+bool PopInputEvent(InputEvent* event)
+{
+    uint32 nextEventToRead = inputEventQueue.nextEventToRead;
+    if (nextEventToRead == __atomic_load_n(&inputEventQueue.nextEventToWrite, __ATOMIC_ACQUIRE)) return false;
+
+    *event = inputEventQueue.events[nextEventToRead];
+    __atomic_store_n(&inputEventQueue.nextEventToRead, (nextEventToRead + 1) % MAX_INPUT_EVENTS, __ATOMIC_RELEASE);
+
+    if (recordingInput) RecordInputEvent(&recording, event);
+    return true;
+}
+
+inline void headless_HandleInputDown(InputCode code)
+{
+    InputEvent event = {INPUTEVENT_DOWN};
+    event.code = code;
+    headless_PushInputEvent(event);
+}
+
+inline void headless_HandleInputUp(InputCode code)
+{
+    InputEvent event = {INPUTEVENT_UP};
+    event.code = code;
+    headless_PushInputEvent(event);
+}
+
+//Returns NUM_INPUTS if there's no key with that name
+internal InputCode headless_InputCodeFromName(char* name)
+{
+    for (int code = 0; code < NUM_INPUTS; ++code)
+    {
+        if (strcmp(InputCodeToStr((InputCode)code), name) == 0) return (InputCode)code;
+    }
+    return NUM_INPUTS;
+}
+
+//
+//FRAMES
+//
+
+struct HeadlessOptions
+{
+    char* sceneFileName;
+    char* dumpDir;
+    char* goldenDir;
+    bool dumpAll;
+    bool replay;
+    char* recordFileName;
+    char* profileFileName;
+    float dt;
+};
+
+struct HeadlessRun
+{
+    HeadlessOptions options;
+    double* frameTimes;
+    int numFrames;
+    int numIdleFrames; //Frames with nothing to redraw, the win32 layer sleeps through these
+    int numDumped;
+    int numGoldenMismatches;
+    bool dumpNextFrame;
+};
+
+//PPMs are top down RGB, the screen buffer is bottom up BGRX
+internal byte* headless_ScreenToPPM(int* ppmLen)
+{
+    char header[64];
+    int headerLen = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", screenBuffer.width, screenBuffer.height);
+
+    *ppmLen = headerLen + screenBuffer.width * screenBuffer.height * 3;
+    byte* ppm = HeapAlloc(byte, *ppmLen);
+    memcpy(ppm, header, headerLen);
+
+    byte* out = ppm + headerLen;
+    for (int y = screenBuffer.height - 1; y >= 0; --y)
+    {
+        uint32* row = (uint32*)screenBuffer.memory + y * screenBuffer.width;
+        for (int x = 0; x < screenBuffer.width; ++x)
+        {
+            *out++ = (byte)(row[x] >> 16);
+            *out++ = (byte)(row[x] >> 8);
+            *out++ = (byte)row[x];
+        }
+    }
+
+    return ppm;
+}
+
+internal void headless_DumpFrame(HeadlessRun* run)
+{
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "frame_%05d.ppm", run->numFrames);
+
+    int ppmLen;
+    byte* ppm = headless_ScreenToPPM(&ppmLen);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", run->options.dumpDir, fileName);
+    if (!WriteToFile(cstring(path), string {(char*)ppm, ppmLen}, false))
+        fprintf(stderr, "Couldn't write %s\n", path);
+
+    if (run->options.goldenDir)
+    {
+        snprintf(path, sizeof(path), "%s/%s", run->options.goldenDir, fileName);
+        int goldenLen = 0;
+        byte* golden = (byte*)ReadEntireFile(cstring(path), &goldenLen);
+        if (!golden || goldenLen != ppmLen || memcmp(golden, ppm, ppmLen) != 0)
+        {
+            fprintf(stderr, "Frame %d doesn't match %s\n", run->numFrames, path);
+            run->numGoldenMismatches++;
+        }
+        free(golden);
+    }
+
+    free(ppm);
+    run->numDumped++;
+}
+
+internal void headless_DrawFrame(HeadlessRun* run, float dt)
+{
+    Assert(run->numFrames < MAX_HEADLESS_FRAMES);
+
+    if (recordingInput) BeginRecordedFrame(&recording, dt);
+
+    DirtyRects dirtyRects;
+    double start = GetSeconds();
+    Draw(dt, &dirtyRects);
+    run->frameTimes[run->numFrames] = GetSeconds() - start;
+    FramePresented(); //There's nothing to present to, so latencies end when Draw does
+    if (dirtyRects.numRects == 0) run->numIdleFrames++;
+
+    if (run->options.dumpDir && (run->dumpNextFrame || run->options.dumpAll))
+        headless_DumpFrame(run);
+    run->dumpNextFrame = false;
+    run->numFrames++;
+
+    FlushStringArena(&temporaryStringArena);
+}
+
+internal void headless_TapKey(HeadlessRun* run, InputCode code, bool shift)
+{
+    if (shift) headless_HandleInputDown(INPUTCODE_LSHIFT);
+    headless_HandleInputDown(code);
+    headless_DrawFrame(run, run->options.dt);
+    headless_HandleInputUp(code);
+    if (shift) headless_HandleInputUp(INPUTCODE_LSHIFT);
+}
+
+//Returns false if the scene has a command that doesn't make sense
+internal bool headless_RunScene(HeadlessRun* run, string scene)
+{
+    int lineNum = 0;
+    char* at = scene.str;
+    while (*at)
+    {
+        char* line = at;
+        while (*at && *at != '\n') at++;
+        if (*at) *at++ = 0;
+        lineNum++;
+
+        int lineLen = (int)strlen(line);
+        if (lineLen && line[lineLen - 1] == '\r') line[--lineLen] = 0;
+        if (lineLen == 0 || line[0] == '#') continue;
+
+        char* arg = strchr(line, ' ');
+        if (arg) *arg++ = 0;
+        else arg = line + lineLen;
+
+        if (strcmp(line, "down") == 0 || strcmp(line, "up") == 0 || strcmp(line, "tap") == 0)
+        {
+            InputCode code = headless_InputCodeFromName(arg);
+            if (code == NUM_INPUTS)
+            {
+                fprintf(stderr, "%s:%d: No key called %s\n", run->options.sceneFileName, lineNum, arg);
+                return false;
+            }
+
+            if (line[0] == 'd') headless_HandleInputDown(code);
+            else if (line[0] == 'u') headless_HandleInputUp(code);
+            else headless_TapKey(run, code, false);
+        }
+        else if (strcmp(line, "type") == 0)
+        {
+            for (char* c = arg; *c; ++c)
+            {
+                InputCode code = CharToInputCode(*c);
+                headless_TapKey(run, code, InputCodeToChar(code, false, false) != *c);
+            }
+        }
+        else if (strcmp(line, "scroll") == 0)
+        {
+            InputEvent event = {INPUTEVENT_SCROLL};
+            event.scrollWheelDelta = (float)atof(arg);
+            headless_PushInputEvent(event);
+        }
+        else if (strcmp(line, "mouse") == 0)
+        {
+            int x = 0, y = 0;
+            sscanf(arg, "%d %d", &x, &y);
+            InputEvent event = {INPUTEVENT_MOUSE_MOVE};
+            event.mousePixelPos = {x, screenBuffer.height - y};
+            headless_PushInputEvent(event);
+        }
+        else if (strcmp(line, "wait") == 0)
+        {
+            for (int i = atoi(arg); i > 0; --i)
+                headless_DrawFrame(run, run->options.dt);
+        }
+        else if (strcmp(line, "dump") == 0)
+        {
+            run->dumpNextFrame = true;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: Unknown command %s\n", run->options.sceneFileName, lineNum, line);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//Returns false if the recording is cut short or isn't one
+internal bool headless_RunReplay(HeadlessRun* run, string replay)
+{
+    InputRecordingHeader* header = (InputRecordingHeader*)replay.str;
+    if (replay.len < (int)sizeof(InputRecordingHeader) || header->magic != INPUT_RECORDING_MAGIC)
+    {
+        fprintf(stderr, "%s isn't an input recording\n", run->options.sceneFileName);
+        return false;
+    }
+    if (header->version != INPUT_RECORDING_VERSION)
+    {
+        fprintf(stderr, "%s is version %u, only version %d can be replayed\n", 
+                run->options.sceneFileName, header->version, INPUT_RECORDING_VERSION);
+        return false;
+    }
+
+    byte* at = (byte*)(header + 1);
+    byte* end = (byte*)replay.str + replay.len;
+    for (int i = 0; i < header->numFrames; ++i)
+    {
+        InputRecordingFrame* frame = (InputRecordingFrame*)at;
+        at += sizeof(InputRecordingFrame);
+        if (at > end || frame->numEvents < 0 || frame->numEvents >= MAX_INPUT_EVENTS ||
+            at + frame->numEvents * sizeof(InputEvent) > end)
+        {
+            fprintf(stderr, "%s: Frame %d is cut short\n", run->options.sceneFileName, i);
+            return false;
+        }
+
+        //The events go in just before the frame that took them, so they're taken by the same Draw as when recorded
+        InputEvent* events = (InputEvent*)at;
+        for (int e = 0; e < frame->numEvents; ++e)
+            headless_PushInputEvent(events[e]);
+        at += frame->numEvents * sizeof(InputEvent);
+
+        if (i == header->numFrames - 1) run->dumpNextFrame = true;
+        headless_DrawFrame(run, frame->dt);
+    }
+
+    return true;
+}
+
+internal int CompareFrameTimes(const void* a, const void* b)
+{
+    double lhs = *(double*)a;
+    double rhs = *(double*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+internal void headless_ReportFrameTimes(HeadlessRun* run)
+{
+    if (run->numFrames == 0) return;
+
+    double* sorted = HeapAlloc(double, run->numFrames);
+    memcpy(sorted, run->frameTimes, run->numFrames * sizeof(double));
+    qsort(sorted, run->numFrames, sizeof(double), CompareFrameTimes);
+
+    double total = 0.0;
+    for (int i = 0; i < run->numFrames; ++i) total += sorted[i];
+
+    printf("%s: %d frames (%d idle), mean %.3fms, p50 %.3fms, p99 %.3fms, max %.3fms\n",
+           run->options.sceneFileName, run->numFrames, run->numIdleFrames,
+           1000.0 * total / run->numFrames,
+           1000.0 * sorted[run->numFrames / 2],
+           1000.0 * sorted[min(run->numFrames * 99 / 100, run->numFrames - 1)],
+           1000.0 * sorted[run->numFrames - 1]);
+
+    free(sorted);
+}
+
+internal void headless_ReportMemory()
+{
+    struct mallinfo2 heap = mallinfo2();
+    printf("Heap: %.1fKB in use, line memory: %u of %u chunks in %u blocks\n",
+           (double)heap.uordblks / 1024.0, lineMemory.numUsedChunks, (uint32)MAX_LINE_MEM_CHUNKS, lineMemory.numUsedBlocks);
+}
+
+//The same input should always leave the same text behind, whatever the frame times were
+internal void headless_ReportDocuments()
+{
+    for (int e = 0; e < numEditors; ++e)
+    {
+        Editor* editor = &editors[e];
+        uint64 hash = 0;
+        int numChars = 0;
+        for (int i = 0; i < editor->numLines; ++i)
+        {
+            hash = HashBytes(editor->lines[i].str, editor->lines[i].len, hash);
+            numChars += editor->lines[i].len;
+        }
+
+        printf("Editor %d: %d lines, %d chars, hash %016llx\n", e, editor->numLines, numChars, (unsigned long long)hash);
+    }
+}
+
+internal void headless_PrintUsage()
+{
+    fprintf(stderr, "Usage: TextEditor_headless [-font <ttf>] [-size <w>x<h>] [-dt <seconds>] [-dump <dir>] "
+                    "[-dumpall] [-golden <dir>] [-record <file>] [-replay] [-profile <file>] "
+                    "<scene file or recording> [file to open]\n"
+                    "       TextEditor_headless -selftest\n");
+}
+
+int main(int argc, char** argv)
+{
+    HeadlessOptions options = {};
+    options.dt = 1.0f / 60.0f;
+    char* fontFileName = nullptr;
+    char* fileName = nullptr;
+    int width = 1280, height = 720;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-font") == 0 && hasValue)
+            fontFileName = argv[++i];
+        else if (strcmp(argv[i], "-size") == 0 && hasValue)
+            sscanf(argv[++i], "%dx%d", &width, &height);
+        else if (strcmp(argv[i], "-dt") == 0 && hasValue)
+            options.dt = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "-dump") == 0 && hasValue)
+            options.dumpDir = argv[++i];
+        else if (strcmp(argv[i], "-dumpall") == 0)
+            options.dumpAll = true;
+        else if (strcmp(argv[i], "-golden") == 0 && hasValue)
+            options.goldenDir = argv[++i];
+        else if (strcmp(argv[i], "-record") == 0 && hasValue)
+            options.recordFileName = argv[++i];
+        else if (strcmp(argv[i], "-replay") == 0)
+            options.replay = true;
+        else if (strcmp(argv[i], "-profile") == 0 && hasValue)
+            options.profileFileName = argv[++i];
+        else if (strcmp(argv[i], "-selftest") == 0)
+            return (TestBlitKernels()) ? 0 : 1;
+        else if (!options.sceneFileName)
+            options.sceneFileName = argv[i];
+        else if (!fileName)
+            fileName = argv[i];
+        else
+        {
+            headless_PrintUsage();
+            return 1;
+        }
+    }
+
+    if (!options.sceneFileName)
+    {
+        headless_PrintUsage();
+        return 1;
+    }
+
+    string scene = ReadEntireFileAsString(cstring(options.sceneFileName));
+    if (!scene.str)
+    {
+        fprintf(stderr, "Couldn't read %s\n", options.sceneFileName);
+        return 1;
+    }
+
+    //Mouse positions are in screen pixels, so a recording only replays the same at the size it was made at
+    InputRecordingHeader* header = (InputRecordingHeader*)scene.str;
+    if (options.replay && scene.len >= (int)sizeof(InputRecordingHeader) && header->magic == INPUT_RECORDING_MAGIC)
+    {
+        width = header->screenWidth;
+        height = header->screenHeight;
+    }
+
+    if (width <= 0 || height <= 0)
+    {
+        headless_PrintUsage();
+        return 1;
+    }
+
+    if (options.goldenDir && !options.dumpDir) options.dumpDir = (char*)".";
+    if (options.dumpDir) MakeDirectory(cstring(options.dumpDir));
+
+    screenBuffer.width = width;
+    screenBuffer.height = height;
+    screenBuffer.memory = HeapAllocZero(uint32, width * height);
+
+    userSettings = LoadUserSettingsFromConfigFile();
+    if (fontFileName) userSettings.fontFile = cstring(fontFileName);
+
+    int ttfFileLen = 0;
+    void* ttfFile = ReadEntireFile(userSettings.fontFile, &ttfFileLen);
+    if (!ttfFile)
+    {
+        fprintf(stderr, "Couldn't read font %.*s\n", userSettings.fontFile.len, userSettings.fontFile.str);
+        return 1;
+    }
+    free(ttfFile);
+
+    //The same order as the win32 layer, other sizes get rasterised as jobs
+    headless_InitJobSystem();
+    ChangeFont(userSettings.fontFile);
+    Init();
+
+    if (fileName)
+    {
+        fileToOpen = cstring(fileName);
+        TE_OpenFile();
+    }
+
+    HeadlessRun run = {};
+    run.options = options;
+    run.frameTimes = HeapAlloc(double, MAX_HEADLESS_FRAMES);
+
+    if (options.recordFileName)
+    {
+        StartInputRecording(&recording);
+        recordingInput = true;
+    }
+    profilingEnabled = PROFILING && options.profileFileName;
+
+    bool sceneRan = (options.replay) ? headless_RunReplay(&run, scene) : headless_RunScene(&run, scene);
+    FinishBackgroundWork();
+    headless_ReportFrameTimes(&run);
+    headless_ReportMemory();
+    headless_ReportDocuments();
+    DumpLatencyStats();
+
+    if (options.recordFileName && !SaveInputRecording(&recording, cstring(options.recordFileName), width, height))
+    {
+        fprintf(stderr, "Couldn't write %s\n", options.recordFileName);
+        sceneRan = false;
+    }
+    if (options.profileFileName && !WriteProfileTrace(cstring(options.profileFileName), -1.0))
+    {
+        fprintf(stderr, "Couldn't write %s\n", options.profileFileName);
+        sceneRan = false;
+    }
+    if (options.goldenDir)
+        printf("%d of %d frames match %s\n", run.numDumped - run.numGoldenMismatches, run.numDumped, options.goldenDir);
+
+    return (sceneRan && run.numGoldenMismatches == 0) ? 0 : 1;
+}
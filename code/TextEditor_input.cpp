@@ -1,4 +1,5 @@
 #include "TextEditor_input.h"
+#include "TextEditor_dynarray.h"
 
 char* InputCodeToStr(InputCode code)
 {
@@ -13,6 +14,19 @@ char* InputCodeToStr(InputCode code)
         case INPUTCODE_UP:    return "UP";
         case INPUTCODE_DOWN:  return "DOWN";
 
+        case INPUTCODE_F1:  return "F1";
+        case INPUTCODE_F2:  return "F2";
+        case INPUTCODE_F3:  return "F3";
+        case INPUTCODE_F4:  return "F4";
+        case INPUTCODE_F5:  return "F5";
+        case INPUTCODE_F6:  return "F6";
+        case INPUTCODE_F7:  return "F7";
+        case INPUTCODE_F8:  return "F8";
+        case INPUTCODE_F9:  return "F9";
+        case INPUTCODE_F10: return "F10";
+        case INPUTCODE_F11: return "F11";
+        case INPUTCODE_F12: return "F12";
+
         case INPUTCODE_SPACE:     return "SPACE";
         case INPUTCODE_BACKSPACE: return "BACKSPACE";
         case INPUTCODE_ENTER:     return "ENTER";
@@ -77,6 +91,39 @@ char* InputCodeToStr(InputCode code)
     }
 };
 
+//Returns true for a press or release that has to be handled, the edge it sets is left for the caller to clear
+bool ApplyInputEvent(Input* input, InputEvent* event)
+{
+    bool result = false;
+    switch (event->type)
+    {
+        case INPUTEVENT_DOWN:
+            //A key that's already held doesn't go down again, e.g. from the OS repeating it
+            if (!InputHeld(input->flags[event->code]))
+            {
+                input->flags[event->code] |= INPUT_DOWN;
+                input->flags[event->code] |= INPUT_HELD;
+                result = true;
+            }
+            break;
+
+        case INPUTEVENT_UP:
+            input->flags[event->code] &= ~INPUT_HELD;
+            input->flags[event->code] |= INPUT_UP;
+            result = true;
+            break;
+
+        case INPUTEVENT_MOUSE_MOVE:
+            input->mousePixelPos = event->mousePixelPos;
+            break;
+
+        case INPUTEVENT_SCROLL:
+            input->scrollWheelDelta += event->scrollWheelDelta;
+            break;
+    }
+    return result;
+}
+
 char InputCodeToChar(InputCode code, bool shift, bool caps)
 {
     if (shift) caps = true;
@@ -127,7 +174,7 @@ InputCode CharToInputCode(char c)
     else if (c >= 'a' && c <= 'z')
         return (InputCode)(c - 'a' + LETTER_START);
     else if (c >= '0' && c <= '9')
-        return (InputCode)(c + NUMBER_START);
+        return (InputCode)(c - '0' + NUMBER_START);
 
     switch(c)
     {
@@ -162,4 +209,60 @@ InputCode CharToInputCode(char c)
 
     Assert(false) //YOU SHOULDN'T HAVE REACHED HERE
     return (InputCode)0;
+}
+
+//
+//RECORDING
+//
+
+internal void* PushToRecording(InputRecording* recording, size_t len)
+{
+    ResizeDynamicArray(&recording->data, recording->len + len, sizeof(byte), &recording->size);
+    void* result = recording->data + recording->len;
+    recording->len += len;
+    return result;
+}
+
+void StartInputRecording(InputRecording* recording)
+{
+    *recording = {0};
+    recording->size = 64 * KILOBYTE;
+    recording->data = HeapAlloc(byte, recording->size);
+
+    //Filled in when the recording is saved
+    PushToRecording(recording, sizeof(InputRecordingHeader));
+}
+
+//Call before each Draw, the events the editor takes during it are added to this frame
+void BeginRecordedFrame(InputRecording* recording, float dt)
+{
+    recording->frameStart = recording->len;
+    InputRecordingFrame* frame = (InputRecordingFrame*)PushToRecording(recording, sizeof(InputRecordingFrame));
+    frame->dt = dt;
+    frame->numEvents = 0;
+    recording->numFrames++;
+}
+
+void RecordInputEvent(InputRecording* recording, InputEvent* event)
+{
+    if (recording->numFrames == 0) return;
+
+    InputEvent* recorded = (InputEvent*)PushToRecording(recording, sizeof(InputEvent));
+    *recorded = *event;
+
+    //Pushing can move the data, so the frame is only found afterwards
+    InputRecordingFrame* frame = (InputRecordingFrame*)(recording->data + recording->frameStart);
+    frame->numEvents++;
+}
+
+bool SaveInputRecording(InputRecording* recording, string fileName, int screenWidth, int screenHeight)
+{
+    InputRecordingHeader* header = (InputRecordingHeader*)recording->data;
+    header->magic = INPUT_RECORDING_MAGIC;
+    header->version = INPUT_RECORDING_VERSION;
+    header->screenWidth = screenWidth;
+    header->screenHeight = screenHeight;
+    header->numFrames = recording->numFrames;
+
+    return WriteToFile(fileName, string {(char*)recording->data, (int)recording->len}, false);
 }
\ No newline at end of file
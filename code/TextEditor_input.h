@@ -1,4 +1,5 @@
 #include "TextEditor_defs.h"
+#include "TextEditor_string.h"
 
 #ifndef TEXT_EDITOR_INPUT_H
 #define TEXT_EDITOR_INPUT_H
@@ -23,18 +24,18 @@ enum InputCode
     INPUTCODE_RIGHT,
     INPUTCODE_DOWN,
 
-    //INPUTCODE_F1,
-    //INPUTCODE_F2,
-    //INPUTCODE_F3,
-    //INPUTCODE_F4,
+    INPUTCODE_F1,
+    INPUTCODE_F2,
+    INPUTCODE_F3,
+    INPUTCODE_F4,
     INPUTCODE_F5,
-    //INPUTCODE_F6,
-    //INPUTCODE_F7,
-    //INPUTCODE_F8,
-    //INPUTCODE_F9,
-    //INPUTCODE_F10,
-    //INPUTCODE_F11,
-    //INPUTCODE_F12,
+    INPUTCODE_F6,
+    INPUTCODE_F7,
+    INPUTCODE_F8,
+    INPUTCODE_F9,
+    INPUTCODE_F10,
+    INPUTCODE_F11,
+    INPUTCODE_F12,
 
     INPUTCODE_BACKSPACE,
     INPUTCODE_LSHIFT,
@@ -138,7 +139,7 @@ struct Input
                 byte arrowKeys[4];
             };  
 
-            byte f5;
+            byte fKeys[12];
 
             byte backspace;
             byte leftShift;
@@ -161,11 +162,67 @@ struct Input
         };
         byte flags[NUM_INPUTS];
     };
+
+};
+
+enum InputEventType
+{
+    INPUTEVENT_DOWN,
+    INPUTEVENT_UP,
+    INPUTEVENT_MOUSE_MOVE,
+    INPUTEVENT_SCROLL
+};
+
+//What the platform layer queues up as it comes in, chars aren't sent separately since they're worked out from keys
+struct InputEvent
+{
+    InputEventType type;
+    double time; //In seconds, on the platform's clock
+    union
+    {
+        InputCode code;
+        IntPair mousePixelPos;
+        float scrollWheelDelta;
+    };
+};
+
+#define INPUT_RECORDING_MAGIC 0x43455254 //"TREC"
+#define INPUT_RECORDING_VERSION 2 //Input codes are saved as they are, so this goes up whenever they change
+
+//A recording file is this header, then for each frame an InputRecordingFrame followed by its events
+struct InputRecordingHeader
+{
+    uint32 magic;
+    uint32 version;
+    int32 screenWidth, screenHeight;
+    int32 numFrames;
+};
+
+struct InputRecordingFrame
+{
+    float dt;
+    int32 numEvents; //The events the editor took during the frame
+};
+
+//Built up in memory by the platform layer as the editor takes events, and written out in one go at the end
+struct InputRecording
+{
+    byte* data;
+    size_t len;
+    size_t size;
+    size_t frameStart; //Where the current frame's InputRecordingFrame is in data
+    int numFrames;
 };
 
 char* InputCodeToStr(InputCode code);
 char InputCodeToChar(InputCode code, bool shift, bool caps);
 InputCode CharToInputCode(char c);
+bool ApplyInputEvent(Input* input, InputEvent* event);
+
+void StartInputRecording(InputRecording* recording);
+void BeginRecordedFrame(InputRecording* recording, float dt);
+void RecordInputEvent(InputRecording* recording, InputEvent* event);
+bool SaveInputRecording(InputRecording* recording, string fileName, int screenWidth, int screenHeight);
 
 inline bool InputDown(byte inputFlags)
 {
@@ -0,0 +1,96 @@
+#include "TextEditor_profile.h"
+
+bool profilingEnabled = false;
+
+//Indexed by job thread, each is allocated by its thread the first time it records anything
+global ProfileThread* profileThreads[MAX_PROFILE_THREADS];
+
+internal void RecordProfileEvent(const char* name, bool begin)
+{
+    int threadIndex = GetJobThreadIndex();
+    Assert(threadIndex < MAX_PROFILE_THREADS);
+
+    ProfileThread* thread = profileThreads[threadIndex];
+    if (!thread)
+    {
+        thread = HeapAllocZero(ProfileThread, 1);
+        profileThreads[threadIndex] = thread;
+    }
+
+    ProfileEvent* event = &thread->events[thread->numEvents % PROFILE_EVENTS_PER_THREAD];
+    event->name = name;
+    event->time = GetSeconds();
+    event->begin = begin;
+    thread->numEvents++;
+}
+
+void BeginProfileZone(const char* name)
+{
+    RecordProfileEvent(name, true);
+}
+
+void EndProfileZone(const char* name)
+{
+    RecordProfileEvent(name, false);
+}
+
+bool WriteProfileTrace(string fileName, double seconds)
+{
+    double now = GetSeconds();
+    double start = (seconds < 0.0) ? 0.0 : now - seconds;
+
+    string_buf json = init_string_buf(64 * KILOBYTE);
+    json += "{\"traceEvents\":[\n";
+    bool first = true;
+
+    char entry[256];
+    for (int t = 0; t < MAX_PROFILE_THREADS; ++t)
+    {
+        ProfileThread* thread = profileThreads[t];
+        if (!thread) continue;
+
+        snprintf(entry, sizeof(entry), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                 "\"args\":{\"name\":\"%s %d\"}}", (first) ? "" : ",\n", t, (t == 0) ? "main" : "worker", t);
+        json += entry;
+        first = false;
+
+        //Ends whose begin has been written over or is too old to be included are left out
+        uint32 end = thread->numEvents;
+        uint32 begin = (end > PROFILE_EVENTS_PER_THREAD) ? end - PROFILE_EVENTS_PER_THREAD : 0;
+        int depth = 0;
+        for (uint32 i = begin; i < end; ++i)
+        {
+            ProfileEvent* event = &thread->events[i % PROFILE_EVENTS_PER_THREAD];
+            if (event->time < start) continue;
+            if (!event->begin && depth == 0) continue;
+            depth += (event->begin) ? 1 : -1;
+
+            snprintf(entry, sizeof(entry), ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                     event->name, (event->begin) ? 'B' : 'E', (event->time - start) * 1e6, t);
+            json += entry;
+        }
+    }
+    json += "\n]}\n";
+
+    bool result = WriteToFile(fileName, json.toStr(), false);
+    json.dealloc();
+    return result;
+}
+
+void ToggleProfiling()
+{
+#if PROFILING
+    profilingEnabled = !profilingEnabled;
+    Print((profilingEnabled) ? "Profiling on\n" : "Profiling off\n");
+#else
+    Print("Built with PROFILING=0, there's nothing to turn on\n");
+#endif
+}
+
+void DumpProfile()
+{
+    if (WriteProfileTrace(lstring("profile.json"), PROFILE_DUMP_SECONDS))
+        Print("Wrote the last few seconds of profiling to profile.json\n");
+    else
+        Print("Couldn't write profile.json\n");
+}
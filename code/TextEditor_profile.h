@@ -0,0 +1,68 @@
+#include "TextEditor_defs.h"
+#include "TextEditor_string.h"
+
+#ifndef TEXT_EDITOR_PROFILE_H
+#define TEXT_EDITOR_PROFILE_H
+
+//Build with -DPROFILING=0 to compile the zones out. Compiled in, nothing is recorded until profiling is
+//turned on and a zone only costs a check of profilingEnabled.
+#ifndef PROFILING
+#define PROFILING 1
+#endif
+
+#define MAX_PROFILE_THREADS 64
+#define PROFILE_EVENTS_PER_THREAD (1 << 16) //Each thread's events are a ring, the oldest get written over
+#define PROFILE_DUMP_SECONDS 5.0
+
+struct ProfileEvent
+{
+    const char* name; //Zones are named with string literals, so only the pointer is kept
+    double time;
+    bool begin;
+};
+
+//Only written to by the thread it belongs to
+struct ProfileThread
+{
+    ProfileEvent events[PROFILE_EVENTS_PER_THREAD];
+    uint32 numEvents; //Carries on counting once the ring wraps
+};
+
+extern bool profilingEnabled;
+
+void BeginProfileZone(const char* name);
+void EndProfileZone(const char* name);
+//What's left in every thread's ring from the last seconds, or all of it if seconds is negative, as Chrome
+//trace JSON (load it in chrome://tracing or Perfetto)
+bool WriteProfileTrace(string fileName, double seconds);
+
+void ToggleProfiling();
+void DumpProfile(); //The last PROFILE_DUMP_SECONDS to profile.json
+
+#if PROFILING
+//Times the scope it's in, a zone that starts whilst profiling is off stays off
+struct ProfileZone
+{
+    const char* name;
+    bool recording;
+
+    ProfileZone(const char* zoneName) : name(zoneName), recording(profilingEnabled)
+    {
+        if (recording) BeginProfileZone(name);
+    }
+    ~ProfileZone()
+    {
+        if (recording) EndProfileZone(name);
+    }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+
+#endif
@@ -0,0 +1,106 @@
+#include "math.h"
+
+#include "TextEditor_stats.h"
+
+//The bucket's upper edge, in seconds
+internal double HistogramBucketLimit(int bucket)
+{
+    return 1e-6 * pow(2.0, (double)(bucket + 1) / HISTOGRAM_BUCKETS_PER_DOUBLING);
+}
+
+void AddToHistogram(Histogram* histogram, double seconds)
+{
+    int bucket = 0;
+    if (seconds > 1e-6)
+        bucket = min((int)(log2(seconds * 1e6) * HISTOGRAM_BUCKETS_PER_DOUBLING), HISTOGRAM_NUM_BUCKETS - 1);
+
+    histogram->buckets[bucket]++;
+    histogram->numSamples++;
+    histogram->maxSeconds = max(histogram->maxSeconds, seconds);
+}
+
+//Percentile is from 0 to 1. Gives the top of the bucket it's in, or the max if that's lower.
+double HistogramPercentile(Histogram* histogram, float percentile)
+{
+    if (histogram->numSamples == 0) return 0.0;
+
+    uint32 rank = (uint32)ceil(percentile * histogram->numSamples);
+    rank = max(rank, 1u);
+
+    uint32 numBelow = 0;
+    for (int i = 0; i < HISTOGRAM_NUM_BUCKETS; ++i)
+    {
+        numBelow += histogram->buckets[i];
+        if (numBelow >= rank) return min(HistogramBucketLimit(i), histogram->maxSeconds);
+    }
+    return histogram->maxSeconds;
+}
+
+char* LatencyStageToStr(LatencyStage stage)
+{
+    switch (stage)
+    {
+        case LATENCY_DISPATCH: return "dispatch";
+        case LATENCY_EDIT:     return "edit";
+        case LATENCY_TOKENISE: return "tokenise";
+        case LATENCY_DRAW:     return "draw";
+        case LATENCY_PRESENT:  return "present";
+        case LATENCY_TOTAL:    return "total";
+
+        default: return "NULL";
+    }
+}
+
+void AddFrameRecord(FrameRecords* frames, FrameRecord* record)
+{
+    frames->records[frames->numRecords % MAX_FRAME_RECORDS] = *record;
+    frames->numRecords++;
+}
+
+int SummariseFrames(FrameRecords* frames, double now, double seconds, 
+                    float averages[NUM_FRAME_STAGES], float maxes[NUM_FRAME_STAGES])
+{
+    for (int s = 0; s < NUM_FRAME_STAGES; ++s)
+    {
+        averages[s] = 0.0f;
+        maxes[s] = 0.0f;
+    }
+
+    //Newest first, so it can stop at the first one that's too old
+    int numFrames = 0;
+    uint32 numInRing = min(frames->numRecords, (uint32)MAX_FRAME_RECORDS);
+    for (uint32 i = 0; i < numInRing; ++i)
+    {
+        FrameRecord* record = &frames->records[(frames->numRecords - 1 - i) % MAX_FRAME_RECORDS];
+        if (record->endTime < now - seconds) break;
+
+        for (int s = 0; s < NUM_FRAME_STAGES; ++s)
+        {
+            averages[s] += record->stages[s];
+            maxes[s] = max(maxes[s], record->stages[s]);
+        }
+        numFrames++;
+    }
+
+    if (numFrames > 0)
+    {
+        for (int s = 0; s < NUM_FRAME_STAGES; ++s)
+            averages[s] /= numFrames;
+    }
+    return numFrames;
+}
+
+char* FrameStageToStr(FrameStage stage)
+{
+    switch (stage)
+    {
+        case FRAME_TOTAL:     return "total";
+        case FRAME_INPUT:     return "input";
+        case FRAME_TOKENISE:  return "tokenise";
+        case FRAME_RASTER:    return "raster";
+        case FRAME_HIGHLIGHT: return "highlight";
+        case FRAME_PRESENT:   return "present";
+
+        default: return "NULL";
+    }
+}
@@ -0,0 +1,77 @@
+#include "TextEditor_defs.h"
+
+#ifndef TEXT_EDITOR_STATS_H
+#define TEXT_EDITOR_STATS_H
+
+//Durations go in log spaced buckets starting at a microsecond, with this many to each doubling, so a
+//percentile read back is never more than 1/11th over
+#define HISTOGRAM_BUCKETS_PER_DOUBLING 8
+#define HISTOGRAM_NUM_BUCKETS (HISTOGRAM_BUCKETS_PER_DOUBLING * 24) //Anything over ~16s goes in the last one
+
+struct Histogram
+{
+    uint32 buckets[HISTOGRAM_NUM_BUCKETS];
+    uint32 numSamples;
+    double maxSeconds;
+};
+
+void AddToHistogram(Histogram* histogram, double seconds);
+double HistogramPercentile(Histogram* histogram, float percentile); //0 if there are no samples
+
+//Where the time goes between a key or button reaching the platform layer and the frame with it in
+//being on screen
+enum LatencyStage
+{
+    LATENCY_DISPATCH, //From the platform getting it to the editor taking it out of the queue
+    LATENCY_EDIT,     //Running the input's bindings, not counting tokenising
+    LATENCY_TOKENISE,
+    LATENCY_DRAW,     //From the frame's input being handled to Draw returning
+    LATENCY_PRESENT,  //From Draw returning to the platform saying the frame is presented
+    LATENCY_TOTAL,
+
+    NUM_LATENCY_STAGES
+};
+
+struct LatencyStats
+{
+    Histogram stages[NUM_LATENCY_STAGES];
+};
+
+char* LatencyStageToStr(LatencyStage stage);
+
+//Where a frame's time goes, from Draw starting to the platform saying it's presented
+enum FrameStage
+{
+    FRAME_TOTAL,
+    FRAME_INPUT,     //Timers and the frame's input, not counting tokenising
+    FRAME_TOKENISE,
+    FRAME_RASTER,    //Redrawing the dirty regions, not counting working out syntax colours
+    FRAME_HIGHLIGHT, //Working out syntax colours for the lines redrawn
+    FRAME_PRESENT,
+
+    NUM_FRAME_STAGES
+};
+
+#define MAX_FRAME_RECORDS 512 //A ring, enough for a second of frames at well over the refresh rate
+
+struct FrameRecord
+{
+    double endTime;
+    float stages[NUM_FRAME_STAGES]; //In seconds
+};
+
+struct FrameRecords
+{
+    FrameRecord records[MAX_FRAME_RECORDS];
+    uint32 numRecords; //Carries on counting once the ring wraps
+};
+
+void AddFrameRecord(FrameRecords* frames, FrameRecord* record);
+//Averages and maxes of each stage over the frames that ended in the last seconds before now, returns how
+//many frames that was
+int SummariseFrames(FrameRecords* frames, double now, double seconds, 
+                    float averages[NUM_FRAME_STAGES], float maxes[NUM_FRAME_STAGES]);
+
+char* FrameStageToStr(FrameStage stage);
+
+#endif
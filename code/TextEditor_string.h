@@ -222,6 +222,35 @@ inline string AdvanceString(string s, int advance)
     return (advance < s.len) ? string{s.str + advance, s.len - advance} : string{0, 0};
 }
 
+#define UNICODE_REPLACEMENT_CHAR 0xFFFD
+
+//Decodes the UTF-8 char starting at s[at] and sets len to how many bytes it takes up. Bytes that don't start
+//a valid char decode as a replacement char one byte long.
+inline uint32 DecodeUTF8(string s, int at, int* len)
+{
+    uchar c = (uchar)s.str[at];
+    *len = 1;
+    if (c < 0x80) return c;
+
+    int numContinuationBytes;
+    uint32 result;
+    if ((c & 0xE0) == 0xC0)      { numContinuationBytes = 1; result = c & 0x1F; }
+    else if ((c & 0xF0) == 0xE0) { numContinuationBytes = 2; result = c & 0x0F; }
+    else if ((c & 0xF8) == 0xF0) { numContinuationBytes = 3; result = c & 0x07; }
+    else return UNICODE_REPLACEMENT_CHAR;
+
+    if (at + numContinuationBytes >= s.len) return UNICODE_REPLACEMENT_CHAR;
+    for (int i = 1; i <= numContinuationBytes; ++i)
+    {
+        uchar continuation = (uchar)s.str[at + i];
+        if ((continuation & 0xC0) != 0x80) return UNICODE_REPLACEMENT_CHAR;
+        result = (result << 6) | (continuation & 0x3F);
+    }
+
+    *len = numContinuationBytes + 1;
+    return result;
+}
+
 string AdvanceToCharAndSplitString(string* src, char target);
 string GetNextLine(string* src);
 byte StringToByte(string src, bool* success);
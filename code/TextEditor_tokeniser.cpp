@@ -3,8 +3,137 @@
 #include "TextEditor_string.h"
 #include "TextEditor_tokeniser.h"
 #include "TextEditor_dynarray.h"
+#include "TextEditor_hash.h"
 
-#define INITIAL_TYPEDEFS_SIZE 64
+#define INITIAL_DEFINITIONS_SIZE 64
+
+//Files shorter than this many lines per chunk aren't worth splitting up across threads
+#define MIN_LINES_PER_TOKENISE_CHUNK 256
+#define MAX_TOKENISE_CHUNKS 16
+
+#define MAX_GRAMMARS 16
+#define MAX_GRAMMAR_EXTENSIONS 8
+#define MAX_GRAMMAR_LIST_LEN 32
+#define GRAMMAR_KEYWORD_TABLE_SIZE 256 //Must be a power of 2
+#define GRAMMAR_STRING_POOL_SIZE 4096
+
+#define GRAMMAR_FILE "config/config_grammars.txt"
+#define CACHE_DIRECTORY "cache"
+#define GRAMMAR_CACHE_FILE "cache/grammars.bin"
+#define GRAMMAR_CACHE_MAGIC 0x4D525247 //GRRM
+#define GRAMMAR_CACHE_VERSION 1
+
+enum CharType
+{
+    CHARTYPE_UNKNOWN,
+    CHARTYPE_WHITESPACE,
+    CHARTYPE_IDENTIFIER,
+    CHARTYPE_DIGIT,
+    CHARTYPE_PUNCTUATION,
+    CHARTYPE_OPERATOR,
+    CHARTYPE_STRING,
+    CHARTYPE_PREPROCESSOR
+};
+
+#define CHARFLAG_IDENTIFIER_PART 0b001
+#define CHARFLAG_STARTS_COMMENT 0b010
+#define CHARFLAG_STARTS_MULTICHAR_TOKEN 0b100
+
+//What else a word does besides being coloured
+enum KeywordAction
+{
+    KEYWORDACTION_NONE,
+    KEYWORDACTION_TYPEDEF,      //The word before the next ; becomes a type, e.g. typedef
+    KEYWORDACTION_DECLARE_TYPE, //The next word becomes a type, e.g. struct
+    KEYWORDACTION_DEFINE,       //The next word becomes a define, e.g. #define
+    KEYWORDACTION_INCLUDE       //<...> after it on the same line is a string, e.g. #include
+};
+
+struct GrammarString
+{
+    uint16 at; //Into Grammar::stringPool
+    uint16 len;
+};
+
+struct GrammarKeyword
+{
+    GrammarString text;
+    uint8 type;
+    uint8 action;
+};
+
+//A language from config/config_grammars.txt compiled into lookup tables for the lexer. This holds no 
+//pointers so it can be written to and read from the grammar cache as is.
+struct Grammar
+{
+    GrammarString name;
+    GrammarString extensions[MAX_GRAMMAR_EXTENSIONS];
+    int numExtensions;
+
+    uint8 charTypes[256];
+    uint8 charFlags[256];
+
+    GrammarString lineComment;
+    GrammarString blockCommentStart;
+    GrammarString blockCommentEnd;
+
+    char primaryStringDelimiter; //Strings carried over from the line before end on this
+    char escapeChar;
+    bool multilineStrings;
+    bool hasIncludeKeywords;
+    char digitSeparator;
+
+    GrammarString numberPrefixes[MAX_GRAMMAR_LIST_LEN];
+    int numNumberPrefixes;
+    GrammarString integerSuffixes[MAX_GRAMMAR_LIST_LEN];
+    int numIntegerSuffixes;
+    GrammarString floatSuffixes[MAX_GRAMMAR_LIST_LEN];
+    int numFloatSuffixes;
+
+    GrammarString multiCharTokens[MAX_GRAMMAR_LIST_LEN];
+    uint8 multiCharTokenTypes[MAX_GRAMMAR_LIST_LEN];
+    int numMultiCharTokens;
+
+    GrammarKeyword keywords[GRAMMAR_KEYWORD_TABLE_SIZE];
+    int numKeywords;
+    int longestKeywordLen;
+
+    char stringPool[GRAMMAR_STRING_POOL_SIZE];
+    int stringPoolUsed;
+};
+
+struct GrammarCacheHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint64 sourceHash;
+    int numGrammars;
+};
+
+#define TOKEN_CACHE_DIRECTORY "cache/tokens"
+#define TOKEN_CACHE_MAGIC 0x4E4B4F54 //TOKN
+#define TOKEN_CACHE_VERSION 2
+
+//Cached tokens are stored in cache/tokens/<file name hash>.bin, so each file only ever has the one entry
+//which is overwritten when it changes, and the header's content hash says which contents it was for
+struct TokenCacheHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint64 contentHash;
+    int numLines;
+    int numTokens;
+    int numDefs;
+};
+
+//Definitions point into the editor's lines, so on disk they are stored as positions
+struct CachedDefinition
+{
+    EditorPos definedAt;
+    EditorPos textAt;
+    int len;
+    bool isTypedef;
+};
 
 union TokenColours
 {
@@ -28,29 +157,86 @@ union TokenColours
     Colour colours[NUM_TOKENS - 1];
 };
 
-struct LineView
+//A typedef/struct/enum name or a #define
+struct Definition
 {
-    int lineIndex;
+    EditorPos definedAt; //Position of the token that introduced it, only tokens after this can see it
+    bool isTypedef;
     string text;
 };
 
+//Every name that has been defined, with the index of the first typedef and first #define of it in the list
+struct DefinitionName
+{
+    string text; //Null str for an empty slot
+    int firstDef[2]; //Indexed by isTypedef, INT32_MAX if it's never defined as that kind
+};
+
+struct DefinitionList
+{
+    Definition* defs = nullptr;
+    int numDefs = 0;
+    int size = INITIAL_DEFINITIONS_SIZE;
+
+    //Open addressed and kept at most half full, rebuilt by IndexDefinitions once the list is complete
+    DefinitionName* names = nullptr;
+    int namesSize = 0; //Power of 2
+};
+
+//A run of lines that is lexed once for every MultilineState it could start in, since we don't know 
+//which state it really starts in until the chunks before it have been lexed.
+struct TokeniseChunk
+{
+    Editor* editor;
+    Grammar* grammar;
+    int firstLine;
+    int onePastLastLine;
+
+    TokenInfo tokenInfos[3];
+    DefinitionList definitions[3];
+    MultilineState endStates[3];
+
+    TokenInfo* stitchedTokenInfo;
+    DefinitionList* stitchedDefinitions;
+};
+
+struct TokeniseWork
+{
+    TokeniseChunk* chunk;
+    MultilineState startState;
+};
+
+struct TokeniseStitch
+{
+    Editor* editor;
+    TokenInfo* tokenInfo;
+    DefinitionList* definitionList;
+    int numChunks;
+};
+
 //extern TokenInfo tokenInfo; //TODO: Make this internal
 
 TokenColours tokenColours;
 
 //DefinedTokenHashSet types = InitHashSet();
-LineView typedefs[INITIAL_TYPEDEFS_SIZE];
-int numTypedefs = 0;
+DefinitionList definitions[3]; //One for each editor, like tokenInfos
+
+TokeniseChunk tokeniseChunks[MAX_TOKENISE_CHUNKS];
+TokeniseWork tokeniseWork[MAX_TOKENISE_CHUNKS * 3];
+TokeniseStitch tokeniseStitch;
+JobCounter tokeniseLexCounter; //Just the lexing
+JobCounter tokeniseCounter; //The whole of TokeniseEditor
 
-//DefinedTokenHashSet defines = InitHashSet();
-LineView poundDefines[INITIAL_TYPEDEFS_SIZE];
-int numPoundDefines = 0;
+Grammar grammars[MAX_GRAMMARS];
+uint64 grammarHashes[MAX_GRAMMARS];
+int numGrammars = 0;
 
 void LoadTokenColours()
 {
     //TODO: Log error or something
     string file = ReadEntireFileAsString(lstring("config/config_tokeniser.txt"));
     Assert(file.str);
+    char* startOfFile = file.str;
 
     string line = GetNextLine(&file);
     for (int i = 0; line[0]; ++i)
@@ -77,102 +263,88 @@ void LoadTokenColours()
         line = GetNextLine(&file);
     }
 
-    FreeWin32(file.str);
+    FreeWin32(startOfFile);
 }
 
-const string integerSuffixes[] = 
+DefinitionList InitDefinitionList()
 {
-    lstring("u"), 
-    lstring("l"),  
+    DefinitionList result;
+    result.defs = HeapAlloc(Definition, result.size);
+    return result;
+}
 
-    lstring("ul"), lstring("lu"),
-    lstring("Ul"), lstring("lU"), 
-    lstring("uL"), lstring("Lu"), 
-    lstring("UL"), lstring("LU"),
+void AddDefinition(DefinitionList* definitionList, EditorPos definedAt, bool isTypedef, string text)
+{
+    Definition definition = {definedAt, isTypedef, text};
+    AppendToDynamicArray(definitionList->defs, definitionList->numDefs, definition, definitionList->size);
+}
 
-    lstring("ull"), lstring("llu"),
-    lstring("uLL"), lstring("LLu"),
-    lstring("Ull"), lstring("llU"),
-    lstring("ULL"), lstring("LLU")
-};
+inline uint32 HashDefinitionName(string text)
+{
+    return (uint32)HashBytes(text.str, text.len);
+}
 
-//TODO: also include suffixes
-bool IsNumber(string str)
+//Must be called after the list is filled in and before anything looks a definition up. The definitions
+//are in the order they're defined, so the first of each kind with a name is also the earliest.
+internal void IndexDefinitions(DefinitionList* definitionList)
 {
-    string suffix = str;
-    //Checking for binary and hexadecimal numbers
-	if (str.len >= 3 && CharInString(str[1], lstring("xXbB")))
+    int namesSize = 64;
+    while (namesSize < 2 * definitionList->numDefs) namesSize *= 2;
+    if (namesSize > definitionList->namesSize)
     {
-        if (str[0] != '0') return false;
-
-        suffix.str += 2;
-        suffix.len -= 2;
+        free(definitionList->names);
+        definitionList->names = HeapAlloc(DefinitionName, namesSize);
+        definitionList->namesSize = namesSize;
     }
-    
-    //Get suffix of number
-    bool encounteredDecimalPoint = false;
-    while(suffix.len > 0 && (IsNumeric(suffix[0]) || suffix[0] == '.'))
+    memset(definitionList->names, 0, definitionList->namesSize * sizeof(DefinitionName));
+
+    uint32 mask = (uint32)definitionList->namesSize - 1;
+    for (int d = 0; d < definitionList->numDefs; ++d)
     {
-        if (suffix[0] == '.') 
+        Definition* def = &definitionList->defs[d];
+        uint32 slot = HashDefinitionName(def->text) & mask;
+        DefinitionName* name = &definitionList->names[slot];
+        while (name->text.str && name->text != def->text)
         {
-            if (encounteredDecimalPoint) return false;
-            encounteredDecimalPoint = true;
+            slot = (slot + 1) & mask;
+            name = &definitionList->names[slot];
         }
-        suffix.str++;
-        suffix.len--;
-    }
 
-    //Check all the suffix cases
-    if (suffix.len == 0) return true;
-    if (encounteredDecimalPoint) return suffix == "f" || suffix == "l";
-        
-    for (int i = 0; i < StackArrayLen(integerSuffixes); ++i)
-    {
-        if (suffix == integerSuffixes[i]) return true;
+        if (!name->text.str)
+        {
+            name->text = def->text;
+            name->firstDef[0] = INT32_MAX;
+            name->firstDef[1] = INT32_MAX;
+        }
+        name->firstDef[def->isTypedef] = min(name->firstDef[def->isTypedef], d);
     }
-    return false;
-
-    
-}
-
-bool IsBool(string str)
-{
-    return str == lstring("true") || str == lstring("false");
 }
 
-bool IsInStringArray(string str, string* stringArr, int arrLen)
+//Only sees the first numVisibleDefs definitions, i.e. the ones defined before the token
+bool DefinitionExists(DefinitionList* definitionList, bool isTypedef, string text, int numVisibleDefs)
 {
-    for (int i = 0; i < arrLen; ++i)
+    uint32 mask = (uint32)definitionList->namesSize - 1;
+    uint32 slot = HashDefinitionName(text) & mask;
+    while (definitionList->names[slot].text.str)
     {
-        if (stringArr[i] == str)
-            return true;
+        if (definitionList->names[slot].text == text) 
+            return definitionList->names[slot].firstDef[isTypedef] < numVisibleDefs;
+        slot = (slot + 1) & mask;
     }
     return false;
 }
 
-bool DefinitionExists(bool isTypedef, Token token)
-{
-    LineView* definitions = (isTypedef) ? typedefs : poundDefines;
-    int numDefinitions = (isTypedef) ? numTypedefs : numPoundDefines;
-    for (int i = 0; i < numDefinitions; ++i)
-    {
-        if (definitions[i].text == token.text)
-            return true;
-    } 
-    return false;
-}
-
-inline bool PoundDefineExists(Token token)
+inline bool PoundDefineExists(DefinitionList* definitionList, string text, int numVisibleDefs)
 {
-    return DefinitionExists(false, token);
+    return DefinitionExists(definitionList, false, text, numVisibleDefs);
 }
 
-inline bool TypedefExists(Token token)
+inline bool TypedefExists(DefinitionList* definitionList, string text, int numVisibleDefs)
 {
-    return DefinitionExists(true, token);
+    return DefinitionExists(definitionList, true, text, numVisibleDefs);
 }
 
-void AddTypeNameForTypedef(Editor* editor, EditorPos at)
+void AddTypeNameForTypedef(Editor* editor, EditorPos at, EditorPos definedAt, DefinitionList* definitionList)
 {
     string_buf currentLine = editor->lines[at.line];
 
@@ -210,74 +382,443 @@ void AddTypeNameForTypedef(Editor* editor, EditorPos at)
             typeStart--;
         string typeText = {currentLine.str + typeStart + 1, at.textAt - typeStart - 1};
 
-        typedefs[numTypedefs++] = {at.line, typeText};
+        AddDefinition(definitionList, definedAt, true, typeText);
     }
 }
 
-string inbuiltTypes[] = 
+//Words in a grammar are looked up through an open addressed hash table, this keeps it sparse so probes stay short
+inline uint32 HashKeyword(string text)
 {
-    lstring("int"), 
-    lstring("short"), 
-    lstring("long"), 
-    lstring("float"), 
-    lstring("double"), 
-    lstring("char"), 
-    lstring("void"), 
-    lstring("bool"), 
-    lstring("struct"), 
-    lstring("class"), 
-    lstring("union"), 
-    lstring("enum"), 
-    lstring("unsigned"),
-    lstring("namespace"),
-    lstring("auto")
-};
+    uint32 hash = 2166136261u;
+    for (int i = 0; i < text.len; ++i) 
+        hash = (hash ^ (uchar)text[i]) * 16777619u;
+    return hash;
+}
 
-string keywords[] = 
-{
-    lstring("return"), 
-    lstring("static"), 
-    lstring("const"), 
-    lstring("if"), 
-    lstring("else"), 
-    lstring("switch"),
-    lstring("case"),
-    lstring("default"),
-    lstring("for"), 
-    lstring("do"),
-    lstring("while"), 
-    lstring("break"),  
-    lstring("typedef"),
-    lstring("inline"),
-    lstring("extern"),
-    lstring("using"),
-    lstring("volatile")
-};
+inline string Grammar_GetString(Grammar* grammar, GrammarString grammarString)
+{
+    return string{grammar->stringPool + grammarString.at, grammarString.len};
+}
 
-string preprocessorTags[] = 
-{
-    lstring("#include"), 
-    lstring("#define"), 
-    lstring("#undef"), 
-    lstring("#if"), 
-    lstring("#elif"), 
-    lstring("#else"), 
-    lstring("#ifdef"), 
-    lstring("#ifndef"),
-    lstring("#endif"),
-    lstring("#error"),
-    lstring("#pragma")
-};
+internal GrammarString Grammar_AddString(Grammar* grammar, string text)
+{
+    Assert(grammar->stringPoolUsed + text.len <= GRAMMAR_STRING_POOL_SIZE);
+
+    GrammarString result = {(uint16)grammar->stringPoolUsed, (uint16)text.len};
+    memcpy(grammar->stringPool + grammar->stringPoolUsed, text.str, text.len);
+    grammar->stringPoolUsed += text.len;
+    return result;
+}
+
+internal GrammarKeyword* FindKeyword(Grammar* grammar, string text)
+{
+    if (text.len > grammar->longestKeywordLen) return nullptr;
+
+    uint32 slot = HashKeyword(text) & (GRAMMAR_KEYWORD_TABLE_SIZE - 1);
+    while (grammar->keywords[slot].text.len > 0)
+    {
+        if (Grammar_GetString(grammar, grammar->keywords[slot].text) == text) 
+            return &grammar->keywords[slot];
+        slot = (slot + 1) & (GRAMMAR_KEYWORD_TABLE_SIZE - 1);
+    }
+    return nullptr;
+}
+
+//Words default to being keywords with no action
+internal GrammarKeyword* Grammar_GetOrAddKeyword(Grammar* grammar, string text)
+{
+    GrammarKeyword* keyword = FindKeyword(grammar, text);
+    if (keyword) return keyword;
+
+    Assert(grammar->numKeywords < GRAMMAR_KEYWORD_TABLE_SIZE / 2);
+
+    uint32 slot = HashKeyword(text) & (GRAMMAR_KEYWORD_TABLE_SIZE - 1);
+    while (grammar->keywords[slot].text.len > 0) 
+        slot = (slot + 1) & (GRAMMAR_KEYWORD_TABLE_SIZE - 1);
+
+    keyword = &grammar->keywords[slot];
+    keyword->text = Grammar_AddString(grammar, text);
+    keyword->type = TOKEN_KEYWORD;
+    keyword->action = KEYWORDACTION_NONE;
+
+    grammar->numKeywords++;
+    grammar->longestKeywordLen = max(grammar->longestKeywordLen, text.len);
+    return keyword;
+}
+
+internal void Grammar_AddToList(Grammar* grammar, GrammarString* list, int* listLen, string text)
+{
+    Assert(*listLen < MAX_GRAMMAR_LIST_LEN);
+    list[(*listLen)++] = Grammar_AddString(grammar, text);
+}
+
+internal void InitGrammar(Grammar* grammar, string name)
+{
+    memset(grammar, 0, sizeof(Grammar));
+    grammar->name = Grammar_AddString(grammar, name);
+
+    for (int c = 0; c < 256; ++c)
+    {
+        if (IsWhiteSpace((char)c))
+            grammar->charTypes[c] = CHARTYPE_WHITESPACE;
+        else if (IsAlphabetical((char)c) || c == '_')
+            grammar->charTypes[c] = CHARTYPE_IDENTIFIER;
+        else if (IsNumeric((char)c))
+            grammar->charTypes[c] = CHARTYPE_DIGIT;
+
+        if (IsAlphaNumeric((char)c) || c == '_') 
+            grammar->charFlags[c] |= CHARFLAG_IDENTIFIER_PART;
+    }
+}
+
+internal string GetNextWord(string* src)
+{
+    while (src->len > 0 && IsWhiteSpace((*src)[0]))
+    {
+        src->str++;
+        src->len--;
+    }
+
+    string result = {src->str, 0};
+    while (result.len < src->len && !IsWhiteSpace(result[result.len])) 
+        result.len++;
+
+    src->str += result.len;
+    src->len -= result.len;
+    return result;
+}
+
+#define ForEachWord(word, line) for (string word = GetNextWord(&(line)); word.len > 0; word = GetNextWord(&(line)))
+
+//Each language starts with "language <name>", the lines after it are "<setting> <values seperated by spaces>"
+internal void CompileGrammars(string file)
+{
+    numGrammars = 0;
+    Grammar* grammar = nullptr;
+
+    while (file.len > 0)
+    {
+        string line = GetNextLine(&file);
+        string setting = GetNextWord(&line);
+        if (setting.len == 0) continue;
+
+        if (setting == lstring("language"))
+        {
+            Assert(numGrammars < MAX_GRAMMARS);
+            grammar = &grammars[numGrammars++];
+            InitGrammar(grammar, GetNextWord(&line));
+            continue;
+        }
+        Assert(grammar);
+
+        if (setting == lstring("extensions"))
+        {
+            ForEachWord(word, line)
+            {
+                Assert(grammar->numExtensions < MAX_GRAMMAR_EXTENSIONS);
+                grammar->extensions[grammar->numExtensions++] = Grammar_AddString(grammar, word);
+            }
+        }
+        else if (setting == lstring("lineComment"))
+        {
+            string word = GetNextWord(&line);
+            grammar->lineComment = Grammar_AddString(grammar, word);
+            if (word.len > 0) grammar->charFlags[(uchar)word[0]] |= CHARFLAG_STARTS_COMMENT;
+        }
+        else if (setting == lstring("blockComment"))
+        {
+            string start = GetNextWord(&line);
+            string end = GetNextWord(&line);
+            Assert(start.len > 0 && end.len > 0);
+
+            grammar->blockCommentStart = Grammar_AddString(grammar, start);
+            grammar->blockCommentEnd = Grammar_AddString(grammar, end);
+            grammar->charFlags[(uchar)start[0]] |= CHARFLAG_STARTS_COMMENT;
+        }
+        else if (setting == lstring("strings"))
+        {
+            ForEachWord(word, line)
+            {
+                grammar->charTypes[(uchar)word[0]] = CHARTYPE_STRING;
+                if (!grammar->primaryStringDelimiter) grammar->primaryStringDelimiter = word[0];
+            }
+        }
+        else if (setting == lstring("escapeChar"))
+        {
+            string word = GetNextWord(&line);
+            grammar->escapeChar = (word.len > 0) ? word[0] : 0;
+        }
+        else if (setting == lstring("multilineStrings"))
+        {
+            grammar->multilineStrings = GetNextWord(&line) == lstring("true");
+        }
+        else if (setting == lstring("digitSeparator"))
+        {
+            string word = GetNextWord(&line);
+            grammar->digitSeparator = (word.len > 0) ? word[0] : 0;
+        }
+        else if (setting == lstring("numberPrefixes"))
+        {
+            ForEachWord(word, line) 
+                Grammar_AddToList(grammar, grammar->numberPrefixes, &grammar->numNumberPrefixes, word);
+        }
+        else if (setting == lstring("integerSuffixes"))
+        {
+            ForEachWord(word, line) 
+                Grammar_AddToList(grammar, grammar->integerSuffixes, &grammar->numIntegerSuffixes, word);
+        }
+        else if (setting == lstring("floatSuffixes"))
+        {
+            ForEachWord(word, line) 
+                Grammar_AddToList(grammar, grammar->floatSuffixes, &grammar->numFloatSuffixes, word);
+        }
+        else if (setting == lstring("punctuation") || setting == lstring("operators"))
+        {
+            bool isPunctuation = setting == lstring("punctuation");
+            ForEachWord(word, line)
+            {
+                if (word.len == 1)
+                {
+                    grammar->charTypes[(uchar)word[0]] = (isPunctuation) ? CHARTYPE_PUNCTUATION : CHARTYPE_OPERATOR;
+                }
+                else
+                {
+                    grammar->multiCharTokenTypes[grammar->numMultiCharTokens] = (isPunctuation) ? TOKEN_PUNCTUATION : TOKEN_OPERATOR;
+                    Grammar_AddToList(grammar, grammar->multiCharTokens, &grammar->numMultiCharTokens, word);
+                    grammar->charFlags[(uchar)word[0]] |= CHARFLAG_STARTS_MULTICHAR_TOKEN;
+                }
+            }
+        }
+        else if (setting == lstring("keywords"))
+        {
+            ForEachWord(word, line) Grammar_GetOrAddKeyword(grammar, word)->type = TOKEN_KEYWORD;
+        }
+        else if (setting == lstring("types"))
+        {
+            ForEachWord(word, line) Grammar_GetOrAddKeyword(grammar, word)->type = TOKEN_INBUILT_TYPE;
+        }
+        else if (setting == lstring("bools"))
+        {
+            ForEachWord(word, line) Grammar_GetOrAddKeyword(grammar, word)->type = TOKEN_BOOL;
+        }
+        else if (setting == lstring("preprocessorTags"))
+        {
+            ForEachWord(word, line)
+            {
+                Grammar_GetOrAddKeyword(grammar, word)->type = TOKEN_PREPROCESSOR_TAG;
+                grammar->charTypes[(uchar)word[0]] = CHARTYPE_PREPROCESSOR;
+            }
+        }
+        else if (setting == lstring("typedefKeywords"))
+        {
+            ForEachWord(word, line) Grammar_GetOrAddKeyword(grammar, word)->action = KEYWORDACTION_TYPEDEF;
+        }
+        else if (setting == lstring("typeDeclarationKeywords"))
+        {
+            ForEachWord(word, line) Grammar_GetOrAddKeyword(grammar, word)->action = KEYWORDACTION_DECLARE_TYPE;
+        }
+        else if (setting == lstring("defineKeywords"))
+        {
+            ForEachWord(word, line) Grammar_GetOrAddKeyword(grammar, word)->action = KEYWORDACTION_DEFINE;
+        }
+        else if (setting == lstring("includeKeywords"))
+        {
+            ForEachWord(word, line) Grammar_GetOrAddKeyword(grammar, word)->action = KEYWORDACTION_INCLUDE;
+            grammar->hasIncludeKeywords = true;
+        }
+        else
+        {
+            //TODO: Log unknown setting
+        }
+    }
+}
+
+//Grammars are compiled into plain tables with no pointers, so the compiled form is cached as is and
+//loaded straight back in if config/config_grammars.txt hasn't changed since
+void LoadGrammars()
+{
+    //TODO: Log error or something
+    string source = ReadEntireFileAsString(lstring(GRAMMAR_FILE));
+    Assert(source.str);
+    uint64 sourceHash = HashBytes(source.str, source.len);
+
+    bool loadedFromCache = false;
+    int cacheLen = 0;
+    byte* cache = (byte*)ReadEntireFile(lstring(GRAMMAR_CACHE_FILE), &cacheLen);
+    if (cache)
+    {
+        GrammarCacheHeader* header = (GrammarCacheHeader*)cache;
+        loadedFromCache = cacheLen >= (int)sizeof(GrammarCacheHeader) &&
+                          header->magic == GRAMMAR_CACHE_MAGIC &&
+                          header->version == GRAMMAR_CACHE_VERSION &&
+                          header->sourceHash == sourceHash &&
+                          header->numGrammars >= 0 && header->numGrammars <= MAX_GRAMMARS &&
+                          cacheLen == (int)(sizeof(GrammarCacheHeader) + header->numGrammars * sizeof(Grammar));
+        if (loadedFromCache)
+        {
+            numGrammars = header->numGrammars;
+            memcpy(grammars, cache + sizeof(GrammarCacheHeader), numGrammars * sizeof(Grammar));
+        }
+        FreeWin32(cache);
+    }
+
+    if (!loadedFromCache)
+    {
+        CompileGrammars(source);
+
+        int newCacheLen = sizeof(GrammarCacheHeader) + numGrammars * sizeof(Grammar);
+        byte* newCache = HeapAlloc(byte, newCacheLen);
+        GrammarCacheHeader header = {GRAMMAR_CACHE_MAGIC, GRAMMAR_CACHE_VERSION, sourceHash, numGrammars};
+        memcpy(newCache, &header, sizeof(header));
+        memcpy(newCache + sizeof(header), grammars, numGrammars * sizeof(Grammar));
+
+        if (MakeDirectory(lstring(CACHE_DIRECTORY)))
+            WriteToFile(lstring(GRAMMAR_CACHE_FILE), string{(char*)newCache, newCacheLen}, false);
+        free(newCache);
+    }
+    FreeWin32(source.str);
+
+    //Token caches are keyed on these so they get thrown out when a grammar changes
+    for (int g = 0; g < numGrammars; ++g)
+        grammarHashes[g] = HashBytes(&grammars[g], sizeof(Grammar));
+}
+
+internal Grammar* GetGrammarForFile(string fileName)
+{
+    int dotIndex = IndexOfLastCharInString(fileName, '.');
+    if (dotIndex == -1) return nullptr;
+
+    string extension = SubString(fileName, dotIndex + 1);    
+    for (int g = 0; g < numGrammars; ++g)
+    {
+        for (int e = 0; e < grammars[g].numExtensions; ++e)
+        {
+            if (extension == Grammar_GetString(&grammars[g], grammars[g].extensions[e])) return &grammars[g];
+        }
+    }
+    return nullptr;
+}
+
+bool IsTokenisable(string fileName)
+{
+    return GetGrammarForFile(fileName) != nullptr;
+}
+
+bool IsNumber(Grammar* grammar, string str)
+{
+    string suffix = str;
+
+    //Checking for binary and hexadecimal numbers
+    bool hasPrefix = false;
+    for (int i = 0; i < grammar->numNumberPrefixes; ++i)
+    {
+        string prefix = Grammar_GetString(grammar, grammar->numberPrefixes[i]);
+        if (str.len > prefix.len && string{str.str, prefix.len} == prefix)
+        {
+            suffix = AdvanceString(str, prefix.len);
+            hasPrefix = true;
+            break;
+        }
+    }
+    
+    //Get suffix of number
+    bool encounteredDecimalPoint = false;
+    while(suffix.len > 0)
+    {
+        char c = suffix[0];
+        bool isHexDigit = InRange(c, 'a', 'f') || InRange(c, 'A', 'F');
+        bool isSeparator = grammar->digitSeparator && c == grammar->digitSeparator;
+        if (!IsNumeric(c) && c != '.' && !isSeparator && !(hasPrefix && isHexDigit)) break;
+
+        if (c == '.') 
+        {
+            if (encounteredDecimalPoint || hasPrefix) return false;
+            encounteredDecimalPoint = true;
+        }
+        suffix.str++;
+        suffix.len--;
+    }
+
+    //Check all the suffix cases
+    if (suffix.len == 0) return true;
+
+    GrammarString* suffixes = (encounteredDecimalPoint) ? grammar->floatSuffixes : grammar->integerSuffixes;
+    int numSuffixes = (encounteredDecimalPoint) ? grammar->numFloatSuffixes : grammar->numIntegerSuffixes;
+    for (int i = 0; i < numSuffixes; ++i)
+    {
+        if (suffix == Grammar_GetString(grammar, suffixes[i])) return true;
+    }
+    return false;
+}
+
+//Returns the index just past the first target at or after from, or -1 if there isn't one
+internal int FindInLine(string_buf code, int from, string target)
+{
+    for (int i = from; i + target.len <= code.len; ++i)
+    {
+        if (memcmp(code.str + i, target.str, target.len) == 0) return i + target.len;
+    }
+    return -1;
+}
+
+inline bool LineHasStringAt(string_buf code, int at, string target)
+{
+    return target.len > 0 && at + target.len <= code.len && memcmp(code.str + at, target.str, target.len) == 0;
+}
+
+//Returns the index just past the closing delimiter, or -1 if the string carries on past the end of the line
+internal int EndOfString(Grammar* grammar, string_buf code, int at, char delimiter)
+{
+    while (at < code.len)
+    {
+        if (grammar->escapeChar && code[at] == grammar->escapeChar) at += 2;
+        else if (code[at] == delimiter) return at + 1;
+        else ++at;
+    }
+    return -1;
+}
+
+//e.g. the name after a struct or #define
+internal void AddNextWordAsDefinition(Grammar* grammar, string_buf code, int at, EditorPos definedAt, bool isTypedef, 
+                                      DefinitionList* definitionList)
+{
+    while (at < code.len && IsWhiteSpace(code[at])) 
+        ++at;
+
+    int end = at;
+    while (end < code.len && (grammar->charFlags[(uchar)code[end]] & CHARFLAG_IDENTIFIER_PART)) 
+        ++end;
+
+    if (end > at)
+        AddDefinition(definitionList, definedAt, isTypedef, string{code.str + at, end - at});
+}
+
+internal bool LineStartsWithInclude(Grammar* grammar, string_buf code)
+{
+    int start = 0;
+    while (start < code.len && IsWhiteSpace(code[start])) 
+        ++start;
+
+    int end = start;
+    while (end < code.len && !IsWhiteSpace(code[end]) && code[end] != '<') 
+        ++end;
+
+    GrammarKeyword* keyword = FindKeyword(grammar, string{code.str + start, end - start});
+    return keyword && keyword->action == KEYWORDACTION_INCLUDE;
+}
 
 //TODO: Make this just get next token or something cause now I realise I need to pass in editor and doing it by line is meaningless now
-Token GetTokenFromLine(Editor* editor, int lineIndex, int* lineAt, MultilineState* ms)
+//NOTE: This must only write to its arguments since lines get lexed on several threads at once. Identifiers
+//which are typedefs or #defines are left as TOKEN_IDENTIFIER, see ResolveDefinedTokens.
+Token GetTokenFromLine(Editor* editor, Grammar* grammar, int lineIndex, int* lineAt, MultilineState* ms, 
+                       DefinitionList* definitionList)
 {
     string_buf code = editor->lines[lineIndex];
 
     if (code.len == 0) return {EditorPos{0, lineIndex}, string{0}, TOKEN_UNKNOWN};
 
 	int at = *lineAt;
-	while (IsWhiteSpace(code[at]) && at < code.len) ++at;
+	while (at < code.len && IsWhiteSpace(code[at])) ++at;
    
 
     Token token = {};
@@ -296,416 +837,769 @@ Token GetTokenFromLine(Editor* editor, int lineIndex, int* lineAt, MultilineStat
         case MS_COMMENT:
         {
             token.type = TOKEN_COMMENT;
-            
-            int start = at;
-            at++;
-            while(at < code.len)
-            {
-                if (code[at] == '/' && code[at - 1] == '*')
-                {
-                    *ms = MS_NON_MULTILINE;
-                    break;
-                }
 
-                at++;
-            } 
+            int end = FindInLine(code, at, Grammar_GetString(grammar, grammar->blockCommentEnd));
+            if (end == -1) end = code.len;
+            else *ms = MS_NON_MULTILINE;
 
-            token.text.len = at - start + (at < code.len);
-            *lineAt = at + (at < code.len);
+            token.text.len = end - at;
+            *lineAt = end;
         } return token;
 
         case MS_STRING: 
         {
             token.type = TOKEN_STRING;
 
-            int start = at;
-            while(at < code.len)
-            {
-                if (code[at] == '"')
-                {
-                    *ms = MS_NON_MULTILINE;
-                    break;
-                }
-                at++;
-            } 
+            int end = EndOfString(grammar, code, at, grammar->primaryStringDelimiter);
+            if (end == -1) end = code.len;
+            else *ms = MS_NON_MULTILINE;
 
-            token.text.len = at - start + (at < code.len);
-            *lineAt = at + (at < code.len);
+            token.text.len = end - at;
+            *lineAt = end;
         } return token;
 
         case MS_NON_MULTILINE: break;
     }
 
-    token.text.len = 1;
-    char c = code[at];
-    ++at;
-
-    //if (*wantType)
+    uchar c = (uchar)code[at];
 
-    switch(c)
+    //Comments and tokens longer than a char are only looked for after chars that can start them
+    if (grammar->charFlags[c] & CHARFLAG_STARTS_COMMENT)
     {
-        case '\0': 
-            token.type = TOKEN_UNKNOWN; 
-            break;
-
-        case '(': 
-        case ')':     
-        case ';': 
-        case '[':     
-        case ']':      
-        case '{':    
-        case '}':  
-        case ',':   
-        case '.':   
-        case '\\':   
-            token.type = TOKEN_PUNCTUATION; 
-            break;
- 
-        case '+': 
-        case '*': 
-        case '%': 
-        case '=':  
-        case '&': 
-        case '|': 
-        case '^': 
-        case '!': 
-        case '?': 
-        case ':': 
-        case '>':   //NOTE: Don't need to check for arrow operator because the above skips over the > if it is an arrow operator
-            token.type = TOKEN_OPERATOR;      
-            break;
+        if (LineHasStringAt(code, at, Grammar_GetString(grammar, grammar->lineComment)))
+        {
+            token.type = TOKEN_COMMENT;
+            token.text.len = code.len - at;
+            *lineAt = code.len;
+            return token;
+        }
 
-        case '-': 
+        string blockCommentStart = Grammar_GetString(grammar, grammar->blockCommentStart);
+        if (LineHasStringAt(code, at, blockCommentStart))
         {
-            token.type = TOKEN_OPERATOR;
+            token.type = TOKEN_COMMENT;
 
-            if (code[at] == '>')
+            int end = FindInLine(code, at + blockCommentStart.len, Grammar_GetString(grammar, grammar->blockCommentEnd));
+            if (end == -1)
             {
-                token.type = TOKEN_PUNCTUATION;
-                token.text.len = 2;
-                at++;
-            } 
-        } break;
+                end = code.len;
+                *ms = MS_COMMENT;
+            }
 
-        case '/':
-        {
-            token.type = TOKEN_OPERATOR;
+            token.text.len = end - at;
+            *lineAt = end;
+            return token;
+        }
+    }
 
-            if (code[at] == '/' || code[at] == '*')
+    if (grammar->charFlags[c] & CHARFLAG_STARTS_MULTICHAR_TOKEN)
+    {
+        for (int i = 0; i < grammar->numMultiCharTokens; ++i)
+        {
+            string multiCharToken = Grammar_GetString(grammar, grammar->multiCharTokens[i]);
+            if (LineHasStringAt(code, at, multiCharToken))
             {
-				if (code[at] == '*')
-					*ms = MS_COMMENT;
-
-                token.type = TOKEN_COMMENT;
-				token.text.len = code.len - at + 1;
-                at = code.len;   
+                token.type = (TypeOfToken)grammar->multiCharTokenTypes[i];
+                token.text.len = multiCharToken.len;
+                *lineAt = at + multiCharToken.len;
+                return token;
             }
-        } break;
+        }
+    }
+
+    int start = at;
+    ++at;
+
+    switch(grammar->charTypes[c])
+    {
+        case CHARTYPE_PUNCTUATION: 
+            token.type = TOKEN_PUNCTUATION; 
+            break;
 
-        case '<':
+        case CHARTYPE_OPERATOR:
         {
             token.type = TOKEN_OPERATOR;
 
-            string startOfLineText = {code.str, 8};
-            while (IsWhiteSpace(startOfLineText[0])) ++startOfLineText.str;
-            
-            if (startOfLineText == lstring("#include"))
+            if (c == '<' && grammar->hasIncludeKeywords && LineStartsWithInclude(grammar, code))
             {
                 token.type = TOKEN_STRING;
-                
-                int start = at;
+
                 while(at < code.len && code[at] != '>') at++;
-                at += (at < code.len && code[at] == '>');
-                token.text.len = at - start + 1;
+                at += (at < code.len);
             }
         } break;
 
-        case '\'':
-        case '"':
+        case CHARTYPE_STRING:
         {
             token.type = TOKEN_STRING;
 
-            int start = at;
-            while(at < code.len && (code[at] != c || code[at - 1] == '\\')) ++at;
-            token.text.len = at - start + 1;
-            
-            if (at < code.len && code[at] == c)
+            int end = EndOfString(grammar, code, at, (char)c);
+            if (end != -1)
+            {
+                at = end;
+            }
+            else
             {
-                ++token.text.len;
-                ++at;    
+                at = code.len;
+                if (grammar->multilineStrings) *ms = MS_STRING;
             }
-			else
-			{
-				*ms = MS_STRING;
-			}
         } break;
 
-        case '#':
+        case CHARTYPE_PREPROCESSOR:
         {
             token.type = TOKEN_UNKNOWN;
 
-            int start = at;
-            while (IsAlphabetical(code[at]) && at < code.len)
-            {
+            while (at < code.len && IsAlphabetical(code[at])) 
                 ++at;
-            }
-            token.text.len += at - start;
 
-            if (IsInStringArray(token.text, preprocessorTags, StackArrayLen(preprocessorTags)))
+            GrammarKeyword* keyword = FindKeyword(grammar, string{code.str + start, at - start});
+            if (keyword && keyword->type == TOKEN_PREPROCESSOR_TAG)
             {
                 token.type = TOKEN_PREPROCESSOR_TAG;
-                
-                if (token.text == lstring("#define"))
-                {
-                    //Get what's actually defined
-                    int defStart = at;
-					while (defStart < code.len && IsWhiteSpace(code[defStart])) 
-                        ++defStart;
-
-                    int defEnd = defStart;
-                    while (defEnd < code.len && !IsWhiteSpace(code[defEnd])) 
-                        ++defEnd;
-
-                    string poundDefineText = {code.str + defStart, defEnd - defStart};
-					if (poundDefineText.len > 0)
-                        poundDefines[numPoundDefines++] = {lineIndex, poundDefineText};
-                }
+                if (keyword->action == KEYWORDACTION_DEFINE)
+                    AddNextWordAsDefinition(grammar, code, at, token.at, false, definitionList);
             }  
         } break;
 
-        default:
+        case CHARTYPE_IDENTIFIER:
         {
-            token.type = TOKEN_UNKNOWN;
+            while (at < code.len && (grammar->charFlags[(uchar)code[at]] & CHARFLAG_IDENTIFIER_PART))
+                ++at;
 
-            if (IsAlphabetical(c))
-            {
-                int start = at;
-                while (at < code.len && (IsAlphaNumeric(code[at]) || code[at] == '_'))
-                {
-                    ++at;
-                }
-                token.text.len += at - start;
+            GrammarKeyword* keyword = FindKeyword(grammar, string{code.str + start, at - start});
 
-                token.type = TOKEN_IDENTIFIER;
-                if (IsInStringArray(token.text, keywords, StackArrayLen(keywords)))
-                {
-                    token.type = TOKEN_KEYWORD;
+            token.type = TOKEN_IDENTIFIER;
+            if (keyword && keyword->type == TOKEN_KEYWORD)
+                token.type = TOKEN_KEYWORD;
+            else if (at < code.len && code[at] == '(')
+                token.type = TOKEN_FUNCTION;
+            else if (keyword)
+                token.type = (TypeOfToken)keyword->type;
 
-                    if (token.text == lstring("typedef"))
-                        AddTypeNameForTypedef(editor, {at, lineIndex});
-                }
-                else if (code[at] == '(')
-                {
-                    token.type = TOKEN_FUNCTION;
-                }
-                else if (IsInStringArray(token.text, inbuiltTypes, StackArrayLen(inbuiltTypes))) 
-                {
-                    token.type = TOKEN_INBUILT_TYPE;
-                    
-                    //If a struct or enum, add the type
-                    if (token.text == lstring("struct") || token.text == lstring("enum"))
-                    {
-                        int typeStart = at;
-                        while (typeStart < code.len && IsWhiteSpace(code[typeStart])) 
-                            ++typeStart;
-
-                        int typeEnd = typeStart;
-                        while (typeStart < code.len && !IsWhiteSpace(code[typeEnd])) 
-                            ++typeEnd;
-
-                        string typeText = {code.str + typeStart, typeEnd - typeStart};
-                        if (typeText.len > 0)
-                            typedefs[numTypedefs++] = {lineIndex, typeText};
-                    }
-                }
-                else if (IsBool(token.text))
-                {
-                    token.type = TOKEN_BOOL;
-                }
-                else if (PoundDefineExists(token))
+            if (keyword && token.type == keyword->type)
+            {
+                switch (keyword->action)
                 {
-                    token.type = TOKEN_DEFINE;
+                    case KEYWORDACTION_TYPEDEF:
+                        AddTypeNameForTypedef(editor, {at, lineIndex}, token.at, definitionList);
+                        break;
+                    case KEYWORDACTION_DECLARE_TYPE:
+                        AddNextWordAsDefinition(grammar, code, at, token.at, true, definitionList);
+                        break;
+                    case KEYWORDACTION_DEFINE:
+                        AddNextWordAsDefinition(grammar, code, at, token.at, false, definitionList);
+                        break;
+                    default: break;
                 }
-                else if (TypedefExists(token))
-                {
-                    token.type = TOKEN_CUSTOM_TYPE;
-                } 
-                
             }
-            else if (IsNumeric(c))
-            { 
-                int start = at;
-                while (at < code.len && (IsAlphaNumeric(code[at]) || code[at] == '.'))
-                {
-                    ++at;
-                }
-                token.text.len += at - start;
+        } break;
 
-                if (IsNumber(token.text)) token.type = TOKEN_NUMBER;
+        case CHARTYPE_DIGIT:
+        { 
+            while (at < code.len && (IsAlphaNumeric(code[at]) || code[at] == '.' || 
+                                     (grammar->digitSeparator && code[at] == grammar->digitSeparator)))
+            {
+                ++at;
             }
+
+            token.type = (IsNumber(grammar, string{code.str + start, at - start})) ? TOKEN_NUMBER : TOKEN_UNKNOWN;
         } break;
-        
+
+        default:
+            token.type = TOKEN_UNKNOWN;
+            break;
     }
 
+    token.text.len = at - start;
     *lineAt = at; 
     return token;
 }
 
 
+
 TokenInfo InitTokenInfo()
 {
     TokenInfo result;
-    result.tokens = HeapAlloc(Token, result.size);
-    result.lineSkipIndicies = HeapAlloc(int, result.size);
+    result.textAts = HeapAlloc(uint32, result.size);
+    result.lens = HeapAlloc(uint16, result.size);
+    result.types = HeapAlloc(uint8, result.size);
+    result.lineSkipIndicies = HeapAlloc(int, MAX_LINES + 1);
     return result;
 }
 
-string tokenisableFileExtensions[] 
+void TokenInfo_AddToken(TokenInfo* tokenInfo, int textAt, int len, TypeOfToken type)
 {
-    lstring("cpp"),
-    lstring("c"), 
-    lstring("h") 
-};
+    //Tokens longer than a uint16 (e.g. a comment on a massive line) get split up
+    do
+    {
+        int chunkLen = min(len, UINT16_MAX);
 
-bool IsTokenisable(string fileName)
-{
-    int dotIndex = IndexOfLastCharInString(fileName, '.');
-    if (dotIndex == -1) return false;
+        tokenInfo->textAts[tokenInfo->numTokens] = (uint32)textAt;
+        tokenInfo->lens[tokenInfo->numTokens] = (uint16)chunkLen;
+        tokenInfo->types[tokenInfo->numTokens] = (uint8)type;
+        tokenInfo->numTokens++;
 
-    string extension = SubString(fileName, dotIndex + 1);    
-    for (int j = 0; j < StackArrayLen(tokenisableFileExtensions); ++j)
-    {
-        if (extension == tokenisableFileExtensions[j]) return true;
-    }
-    return false;
+        if (tokenInfo->numTokens >= tokenInfo->size)
+        {
+            tokenInfo->size *= 2;
+            tokenInfo->textAts = HeapRealloc(uint32, tokenInfo->textAts, tokenInfo->size);
+            tokenInfo->lens = HeapRealloc(uint16, tokenInfo->lens, tokenInfo->size);
+            tokenInfo->types = HeapRealloc(uint8, tokenInfo->types, tokenInfo->size);
+        }
+
+        textAt += chunkLen;
+        len -= chunkLen;
+    } while (len > 0);
 }
 
-void Tokenise(int editorIndex)
+//Returns the index of the first token whose text contains pos (including its end), or -1 if none does.
+//Finding the line is O(1) through lineSkipIndicies, and tokens on a line are sorted so we binary search.
+int GetTokenIndexAtPos(TokenInfo* tokenInfo, EditorPos pos)
 {
-    if (numEditors > 3) return;
+    if (pos.line < 0 || pos.line >= tokenInfo->numLines) return -1;
 
-    Editor* editor = &editors[editorIndex];
-    if (!IsTokenisable(editor->fileName.toStr())) return; 
+    //Find first token on the line which ends at or after pos
+    int lo = tokenInfo->lineSkipIndicies[pos.line];
+    int hi = tokenInfo->lineSkipIndicies[pos.line + 1];
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if ((int)(tokenInfo->textAts[mid] + tokenInfo->lens[mid]) < pos.textAt)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
-    TokenInfo* tokenInfo = &tokenInfos[editorIndex];
+    if (lo == tokenInfo->lineSkipIndicies[pos.line + 1] || (int)tokenInfo->textAts[lo] > pos.textAt) 
+        return -1;
+    return lo;
+}
 
-    Assert(editor->numLines < MAX_LINES);
+Token GetTokenAtPos(Editor* editor, TokenInfo* tokenInfo, EditorPos pos)
+{
+    int t = GetTokenIndexAtPos(tokenInfo, pos);
+    if (t == -1) return Token{EditorPos{-1, -1}, string{0, 0}, TOKEN_UNKNOWN};
+
+    //Tokens may be stale if the line changed since the last tokenise, so never point past the line
+    int lineLen = editor->lines[pos.line].len;
+    int textAt = min((int)tokenInfo->textAts[t], lineLen);
+    int len = min((int)tokenInfo->lens[t], lineLen - textAt);
+    string text = {editor->lines[pos.line].str + textAt, len};
+    return Token{EditorPos{textAt, pos.line}, text, (TypeOfToken)tokenInfo->types[t]};
+}
 
-    numTypedefs = 0;
-    numPoundDefines = 0;
+//Returns the MultilineState at the end of the lines
+internal MultilineState TokeniseLines(Editor* editor, Grammar* grammar, int firstLine, int onePastLastLine, 
+                                      MultilineState startState, 
+                                      TokenInfo* tokenInfo, DefinitionList* definitionList)
+{
     tokenInfo->numTokens = 0;
+    definitionList->numDefs = 0;
 
-    int tokenIndex = 0;
-    MultilineState multilineState = MS_NON_MULTILINE;
-    for (int i = 0; i < editor->numLines; ++i)
+    MultilineState multilineState = startState;
+    for (int i = firstLine; i < onePastLastLine; ++i)
     {
 		int lineAt = 0;
         bool parsingLine = true;
 
-        tokenInfo->lineSkipIndicies[i] = tokenIndex;
+        tokenInfo->lineSkipIndicies[i - firstLine] = tokenInfo->numTokens;
 
         while (parsingLine)
         {
-            Token token = GetTokenFromLine(editor, i, &lineAt, &multilineState);
+            Token token = GetTokenFromLine(editor, grammar, i, &lineAt, &multilineState, definitionList);
+            TokenInfo_AddToken(tokenInfo, token.at.textAt, token.text.len, token.type);
+            
+            parsingLine = (lineAt < editor->lines[i].len);
+        }
+    }
+    tokenInfo->numLines = onePastLastLine - firstLine;
+    tokenInfo->lineSkipIndicies[tokenInfo->numLines] = tokenInfo->numTokens;
 
-            tokenInfo->tokens[tokenInfo->numTokens++] = token;
-            if (tokenInfo->numTokens >= tokenInfo->size)
+    return multilineState;
+}
+
+//Turns identifiers into TOKEN_DEFINE or TOKEN_CUSTOM_TYPE if they were defined earlier on in the file
+internal void ResolveDefinedTokens(Editor* editor, TokenInfo* tokenInfo, DefinitionList* definitionList, 
+                                   int firstLine, int onePastLastLine)
+{
+    int numVisibleDefs = 0;
+    while (numVisibleDefs < definitionList->numDefs && definitionList->defs[numVisibleDefs].definedAt.line < firstLine)
+        numVisibleDefs++;
+
+    for (int l = firstLine; l < onePastLastLine; ++l)
+    {
+        for (int t = tokenInfo->lineSkipIndicies[l]; t < tokenInfo->lineSkipIndicies[l + 1]; ++t)
+        {
+            int textAt = (int)tokenInfo->textAts[t];
+            while (numVisibleDefs < definitionList->numDefs)
             {
-                tokenInfo->size *= 2;
-                tokenInfo->tokens = HeapRealloc(Token, tokenInfo->tokens, tokenInfo->size);
-                tokenInfo->lineSkipIndicies = HeapRealloc(int, tokenInfo->lineSkipIndicies, tokenInfo->size);
+                EditorPos definedAt = definitionList->defs[numVisibleDefs].definedAt;
+                if (definedAt.line > l || (definedAt.line == l && definedAt.textAt >= textAt)) break;
+                numVisibleDefs++;
             }
-            
-            parsingLine = (lineAt < editor->lines[i].len);
-            tokenIndex++;
+
+            if (tokenInfo->types[t] != TOKEN_IDENTIFIER) continue;
+
+            string text = {editor->lines[l].str + textAt, tokenInfo->lens[t]};
+            if (PoundDefineExists(definitionList, text, numVisibleDefs))
+                tokenInfo->types[t] = TOKEN_DEFINE;
+            else if (TypedefExists(definitionList, text, numVisibleDefs))
+                tokenInfo->types[t] = TOKEN_CUSTOM_TYPE;
         }
     }
 }
 
-void OnFileOpen()
+internal void TokeniseChunkWork(void* data)
 {
-    Tokenise(numEditors - 1);
+    PROFILE_FUNCTION();
+    TokeniseWork* work = (TokeniseWork*)data;
+    TokeniseChunk* chunk = work->chunk;
+    chunk->endStates[work->startState] = TokeniseLines(chunk->editor, chunk->grammar, 
+                                                       chunk->firstLine, chunk->onePastLastLine,
+                                                       work->startState,
+                                                       &chunk->tokenInfos[work->startState], 
+                                                       &chunk->definitions[work->startState]);
 }
 
-void OnTextChanged()
+internal void ResolveChunkWork(void* data)
 {
-    Tokenise(openEditorIndexes[currentEditorSide]);
+    PROFILE_FUNCTION();
+    TokeniseChunk* chunk = (TokeniseChunk*)data;
+    ResolveDefinedTokens(chunk->editor, chunk->stitchedTokenInfo, chunk->stitchedDefinitions, 
+                         chunk->firstLine, chunk->onePastLastLine);
 }
 
-void OnEditorSwitch()
+internal void TokenInfo_Reserve(TokenInfo* tokenInfo, int numTokens)
 {
-    Tokenise(openEditorIndexes[currentEditorSide]);
+    if (numTokens < tokenInfo->size) return;
+
+    while (numTokens >= tokenInfo->size) tokenInfo->size *= 2;
+    tokenInfo->textAts = HeapRealloc(uint32, tokenInfo->textAts, tokenInfo->size);
+    tokenInfo->lens = HeapRealloc(uint16, tokenInfo->lens, tokenInfo->size);
+    tokenInfo->types = HeapRealloc(uint8, tokenInfo->types, tokenInfo->size);
 }
 
-void OnFileSave()
+//Runs once every chunk has been lexed, then resolving the defined tokens is split up by chunk again
+internal void StitchChunksWork(void* data)
 {
-	if (IsTokenisable(editors[openEditorIndexes[currentEditorSide]].fileName.toStr()))
-        Tokenise(openEditorIndexes[currentEditorSide]);
+    PROFILE_FUNCTION();
+    TokeniseStitch* stitch = (TokeniseStitch*)data;
+    Editor* editor = stitch->editor;
+    TokenInfo* tokenInfo = stitch->tokenInfo;
+    DefinitionList* definitionList = stitch->definitionList;
+    int numChunks = stitch->numChunks;
+
+    tokenInfo->numTokens = 0;
+    definitionList->numDefs = 0;
+    MultilineState multilineState = MS_NON_MULTILINE;
+    for (int c = 0; c < numChunks; ++c)
+    {
+        TokeniseChunk* chunk = &tokeniseChunks[c];
+        TokenInfo* chunkTokenInfo = &chunk->tokenInfos[multilineState];
+        DefinitionList* chunkDefinitions = &chunk->definitions[multilineState];
+
+        int tokenStart = tokenInfo->numTokens;
+        TokenInfo_Reserve(tokenInfo, tokenStart + chunkTokenInfo->numTokens);
+        memcpy(tokenInfo->textAts + tokenStart, chunkTokenInfo->textAts, chunkTokenInfo->numTokens * sizeof(uint32));
+        memcpy(tokenInfo->lens + tokenStart, chunkTokenInfo->lens, chunkTokenInfo->numTokens * sizeof(uint16));
+        memcpy(tokenInfo->types + tokenStart, chunkTokenInfo->types, chunkTokenInfo->numTokens * sizeof(uint8));
+        tokenInfo->numTokens += chunkTokenInfo->numTokens;
+
+        for (int l = 0; l < chunkTokenInfo->numLines; ++l)
+            tokenInfo->lineSkipIndicies[chunk->firstLine + l] = tokenStart + chunkTokenInfo->lineSkipIndicies[l];
+
+        for (int d = 0; d < chunkDefinitions->numDefs; ++d)
+        {
+            AppendToDynamicArray(definitionList->defs, definitionList->numDefs, chunkDefinitions->defs[d], 
+                                 definitionList->size);
+        }
+
+        multilineState = chunk->endStates[multilineState];
+    }
+    tokenInfo->numLines = editor->numLines;
+    tokenInfo->lineSkipIndicies[editor->numLines] = tokenInfo->numTokens;
+    IndexDefinitions(definitionList);
+
+    for (int c = 0; c < numChunks; ++c)
+        AddWork(ResolveChunkWork, &tokeniseChunks[c], &tokeniseCounter);
 }
 
-//TODO: Put this in api function
-void HighlightSyntax()
+//Large files are split up into chunks at line boundaries which are lexed in parallel. Every chunk
+//is lexed speculatively for each MultilineState it could start in, then the chunks are stitched 
+//together in order by following the real end state of each one. The stitching waits on the lexing
+//as a job of its own, so the main thread only has to wait for the end.
+internal void TokeniseEditor(Editor* editor, Grammar* grammar, TokenInfo* tokenInfo, DefinitionList* definitionList)
 {
-    for (int e = 0; e < 2; ++e)
+    Assert(editor->numLines < MAX_LINES);
+
+    //Any line's tokens can change, e.g. from a comment being opened above it
+    InvalidateLineHashes(editor);
+
+    if (!definitionList->defs) *definitionList = InitDefinitionList();
+
+    int numChunks = min(editor->numLines / MIN_LINES_PER_TOKENISE_CHUNK, 
+                        min(4 * (GetNumWorkerThreads() + 1), MAX_TOKENISE_CHUNKS));
+    if (numChunks <= 1)
     {
-        Editor* editor = &editors[openEditorIndexes[e]];
-        if (!IsTokenisable(editor->fileName.toStr())) continue; 
+        TokeniseLines(editor, grammar, 0, editor->numLines, MS_NON_MULTILINE, tokenInfo, definitionList);
+        IndexDefinitions(definitionList);
+        ResolveDefinedTokens(editor, tokenInfo, definitionList, 0, editor->numLines);
+        return;
+    }
+
+    int linesPerChunk = editor->numLines / numChunks;
+    for (int c = 0; c < numChunks; ++c)
+    {
+        TokeniseChunk* chunk = &tokeniseChunks[c];
+        chunk->editor = editor;
+        chunk->grammar = grammar;
+        chunk->firstLine = c * linesPerChunk;
+        chunk->onePastLastLine = (c == numChunks - 1) ? editor->numLines : (c + 1) * linesPerChunk;
+        chunk->stitchedTokenInfo = tokenInfo;
+        chunk->stitchedDefinitions = definitionList;
+
+        for (int ms = MS_NON_MULTILINE; ms <= MS_COMMENT; ++ms)
+        {
+            if (!chunk->tokenInfos[ms].textAts) chunk->tokenInfos[ms] = InitTokenInfo();
+            if (!chunk->definitions[ms].defs) chunk->definitions[ms] = InitDefinitionList();
+
+            //Every chunk but the first starts in an unknown state
+            if (c == 0 && ms != MS_NON_MULTILINE) continue;
+
+            TokeniseWork* work = &tokeniseWork[c * 3 + ms];
+            work->chunk = chunk;
+            work->startState = (MultilineState)ms;
+            AddWork(TokeniseChunkWork, work, &tokeniseLexCounter);
+        }
+    }
+
+    tokeniseStitch = {editor, tokenInfo, definitionList, numChunks};
+    AddWork(StitchChunksWork, &tokeniseStitch, &tokeniseCounter, &tokeniseLexCounter);
+    WaitForCounter(&tokeniseCounter);
+}
+
+internal uint64 HashEditorContents(Editor* editor, Grammar* grammar)
+{
+    //Seeding with the grammar means a file tokenised with a different grammar doesn't match
+    uint64 hash = grammarHashes[grammar - grammars];
+    for (int l = 0; l < editor->numLines; ++l)
+        hash = HashBytes(editor->lines[l].str, editor->lines[l].len, hash);
+    return hash;
+}
+
+void Tokenise(int editorIndex)
+{
+    PROFILE_FUNCTION();
 
-        int numLinesOnScreen = screenBuffer.height / (int)(fontData.maxHeight + fontData.lineGap);
-        int firstLine = abs(editor->textOffset.y) / (int)(fontData.maxHeight + fontData.lineGap);
+    if (numEditors > 3) return;
+
+    Editor* editor = &editors[editorIndex];
+    Grammar* grammar = GetGrammarForFile(editor->fileName.toStr());
+    if (!grammar) return; 
+
+    TokeniseEditor(editor, grammar, &tokenInfos[editorIndex], &definitions[editorIndex]);
+    tokenInfos[editorIndex].contentHash = HashEditorContents(editor, grammar);
+}
 
-        TokenInfo tokenInfo = tokenInfos[openEditorIndexes[e]];
+internal string GetTokenCacheFileName(Editor* editor, char* buffer, int bufferLen)
+{
+    uint64 fileNameHash = HashBytes(editor->fileName.str, editor->fileName.len);
+    snprintf(buffer, bufferLen, TOKEN_CACHE_DIRECTORY "/%016llx.bin", (unsigned long long)fileNameHash);
+    return cstring(buffer);
+}
 
-        const IntPair textStart = (e == 0) ? GetLeftTextStart() : GetRightTextStart();
-        const Rect textLimits = (e == 0) ? GetLeftTextLimits() : GetRightTextLimits();
+//The file is the header followed by textAts, lineSkipIndicies, definitions, lens then types
+internal void SaveTokensToCache(int editorIndex)
+{
+    Editor* editor = &editors[editorIndex];
+    TokenInfo* tokenInfo = &tokenInfos[editorIndex];
+    DefinitionList* definitionList = &definitions[editorIndex];
+
+    TokenCacheHeader header = {};
+    header.magic = TOKEN_CACHE_MAGIC;
+    header.version = TOKEN_CACHE_VERSION;
+    header.contentHash = tokenInfo->contentHash;
+    header.numLines = tokenInfo->numLines;
+    header.numTokens = tokenInfo->numTokens;
+    header.numDefs = definitionList->numDefs;
+
+    int fileLen = sizeof(TokenCacheHeader) + 
+                  header.numTokens * (sizeof(uint32) + sizeof(uint16) + sizeof(uint8)) + 
+                  (header.numLines + 1) * sizeof(int) +
+                  header.numDefs * sizeof(CachedDefinition);
+    byte* file = HeapAlloc(byte, fileLen);
+    byte* at = file + sizeof(TokenCacheHeader);
+
+    memcpy(at, tokenInfo->textAts, header.numTokens * sizeof(uint32));
+    at += header.numTokens * sizeof(uint32);
+    memcpy(at, tokenInfo->lineSkipIndicies, (header.numLines + 1) * sizeof(int));
+    at += (header.numLines + 1) * sizeof(int);
+
+    //Definition text points into the lines so store where it is instead
+    int numDefsWritten = 0;
+    for (int d = 0; d < definitionList->numDefs; ++d)
+    {
+        Definition* def = &definitionList->defs[d];
 
-        int x = 0;
-        int numLinesTokenised = 0; 
-        int t = tokenInfo.lineSkipIndicies[firstLine];
-        while (numLinesTokenised < numLinesOnScreen && t < tokenInfo.numTokens)
+        int line = def->definedAt.line;
+        while (line < editor->numLines && 
+               !(def->text.str >= editor->lines[line].str && def->text.str <= editor->lines[line].str + editor->lines[line].len))
         {
-            Token token = tokenInfo.tokens[t];
+            ++line;
+        }
+        if (line == editor->numLines) continue;
+
+        CachedDefinition cachedDef = {};
+        cachedDef.definedAt = def->definedAt;
+        cachedDef.textAt = {(int)(def->text.str - editor->lines[line].str), line};
+        cachedDef.len = def->text.len;
+        cachedDef.isTypedef = def->isTypedef;
+        memcpy(at, &cachedDef, sizeof(CachedDefinition));
+        at += sizeof(CachedDefinition);
+        numDefsWritten++;
+    }
+    header.numDefs = numDefsWritten;
+    fileLen -= (definitionList->numDefs - numDefsWritten) * sizeof(CachedDefinition);
+
+    memcpy(at, tokenInfo->lens, header.numTokens * sizeof(uint16));
+    at += header.numTokens * sizeof(uint16);
+    memcpy(at, tokenInfo->types, header.numTokens * sizeof(uint8));
+    at += header.numTokens * sizeof(uint8);
+    memcpy(file, &header, sizeof(TokenCacheHeader));
 
-            bool prevTokenOnSameLine = t > 0 && tokenInfo.tokens[t - 1].at.line == token.at.line;
-            bool nextTokenOnSameLine = t < tokenInfo.numTokens - 1 && 
-                                        tokenInfo.tokens[t + 1].at.line == token.at.line;
+    char fileNameBuffer[64];
+    if (MakeDirectory(lstring(CACHE_DIRECTORY)) && MakeDirectory(lstring(TOKEN_CACHE_DIRECTORY)))
+    {
+        WriteToFile(GetTokenCacheFileName(editor, fileNameBuffer, sizeof(fileNameBuffer)), 
+                    string{(char*)file, fileLen}, false);
+    }
+    free(file);
+}
 
-            if (t == 0 || !prevTokenOnSameLine)
-                x = textStart.x - editor->textOffset.x;
-            int y = textStart.y - token.at.line * (int)(fontData.maxHeight + fontData.lineGap) 
-                    + editor->textOffset.y;
+//Token text is taken from the editor's lines too, so every line's tokens have to be in order and fit in it
+internal bool CachedTokensFitLines(Editor* editor, byte* textAts, byte* lineSkipIndicies, byte* lens, byte* types, int numTokens)
+{
+    int lineStart;
+    memcpy(&lineStart, lineSkipIndicies, sizeof(int));
+    if (lineStart != 0) return false;
 
-            //Draw whitespace at front of line
-            if (!prevTokenOnSameLine)
-            {
-                if (token.text.str) //TODO: Investigate whether this check is really necessary
-                {
-                    int whitespaceLen = (int)(token.text.str - editor->lines[token.at.line].str);
-                    x += TextPixelLength(editor->lines[token.at.line].str, whitespaceLen);
-                }
-            }
+    for (int l = 0; l < editor->numLines; ++l)
+    {
+        int lineEnd;
+        memcpy(&lineEnd, lineSkipIndicies + (l + 1) * sizeof(int), sizeof(int));
+        if (lineEnd < lineStart || lineEnd > numTokens) return false;
 
-            string text = token.text;
-            Colour textColour = tokenColours.colours[token.type];
+        for (int t = lineStart; t < lineEnd; ++t)
+        {
+            uint32 textAt;
+            uint16 len;
+            memcpy(&textAt, textAts + t * sizeof(uint32), sizeof(uint32));
+            memcpy(&len, lens + t * sizeof(uint16), sizeof(uint16));
+            if ((int64)textAt + len > editor->lines[l].len || types[t] >= NUM_TOKENS - 1) return false;
+        }
+        lineStart = lineEnd;
+    }
 
-            //Draw token
-            DrawText(text, x, y, textColour, textLimits);
-            x += TextPixelLength(text);
+    return lineStart == numTokens;
+}
 
-            //Draw whitespace
-            if (t < tokenInfo.numTokens - 1 && token.text.len > 0 && nextTokenOnSameLine)
-            {
-                text.str += token.text.len;
-                int remainderLength = (int)(tokenInfo.tokens[t + 1].text.str - token.text.str) 
-                                        - token.text.len;
-                text.len = remainderLength;
-                DrawText(text, x, y, textColour, textLimits);
-                x += TextPixelLength(text);
-            }
+internal bool LoadTokensFromCache(int editorIndex, uint64 contentHash)
+{
+    Editor* editor = &editors[editorIndex];
+    TokenInfo* tokenInfo = &tokenInfos[editorIndex];
+    DefinitionList* definitionList = &definitions[editorIndex];
 
-            t++;
-            numLinesTokenised += !nextTokenOnSameLine;
+    char fileNameBuffer[64];
+    int fileLen = 0;
+    byte* file = (byte*)ReadEntireFile(GetTokenCacheFileName(editor, fileNameBuffer, sizeof(fileNameBuffer)), 
+                                       &fileLen);
+    if (!file) return false;
+
+    TokenCacheHeader header;
+    bool valid = fileLen >= (int)sizeof(TokenCacheHeader);
+    if (valid)
+    {
+        memcpy(&header, file, sizeof(TokenCacheHeader));
+        valid = header.magic == TOKEN_CACHE_MAGIC && 
+                header.version == TOKEN_CACHE_VERSION &&
+                header.contentHash == contentHash &&
+                header.numLines == editor->numLines &&
+                header.numTokens >= 0 && header.numDefs >= 0 &&
+                fileLen == (int)(sizeof(TokenCacheHeader) + 
+                                 header.numTokens * (sizeof(uint32) + sizeof(uint16) + sizeof(uint8)) + 
+                                 (header.numLines + 1) * sizeof(int) +
+                                 header.numDefs * sizeof(CachedDefinition));
+
+        //The definitions' text is taken from the editor's lines, so each one has to fit in the file as it is now
+        byte* cachedDefs = file + sizeof(TokenCacheHeader) + header.numTokens * sizeof(uint32) + 
+                           (header.numLines + 1) * sizeof(int);
+        for (int d = 0; valid && d < header.numDefs; ++d)
+        {
+            CachedDefinition cachedDef;
+            memcpy(&cachedDef, cachedDefs + d * sizeof(CachedDefinition), sizeof(CachedDefinition));
+            valid = cachedDef.textAt.line >= 0 && cachedDef.textAt.line < editor->numLines &&
+                    cachedDef.textAt.textAt >= 0 && cachedDef.len >= 0 &&
+                    cachedDef.textAt.textAt + cachedDef.len <= editor->lines[cachedDef.textAt.line].len;
+        }
+
+        byte* textAts = file + sizeof(TokenCacheHeader);
+        byte* lineSkipIndicies = textAts + header.numTokens * sizeof(uint32);
+        byte* lens = cachedDefs + header.numDefs * sizeof(CachedDefinition);
+        valid = valid && CachedTokensFitLines(editor, textAts, lineSkipIndicies, lens, lens + header.numTokens * sizeof(uint16), 
+                                              header.numTokens);
+    }
+
+    if (valid)
+    {
+        byte* at = file + sizeof(TokenCacheHeader);
+
+        TokenInfo_Reserve(tokenInfo, header.numTokens);
+        tokenInfo->numTokens = header.numTokens;
+        tokenInfo->numLines = header.numLines;
+
+        memcpy(tokenInfo->textAts, at, header.numTokens * sizeof(uint32));
+        at += header.numTokens * sizeof(uint32);
+        memcpy(tokenInfo->lineSkipIndicies, at, (header.numLines + 1) * sizeof(int));
+        at += (header.numLines + 1) * sizeof(int);
+
+        if (!definitionList->defs) *definitionList = InitDefinitionList();
+        definitionList->numDefs = 0;
+        for (int d = 0; d < header.numDefs; ++d)
+        {
+            CachedDefinition cachedDef;
+            memcpy(&cachedDef, at, sizeof(CachedDefinition));
+            at += sizeof(CachedDefinition);
+
+            string text = {editor->lines[cachedDef.textAt.line].str + cachedDef.textAt.textAt, cachedDef.len};
+            AddDefinition(definitionList, cachedDef.definedAt, cachedDef.isTypedef, text);
         }
+        IndexDefinitions(definitionList);
+
+        memcpy(tokenInfo->lens, at, header.numTokens * sizeof(uint16));
+        at += header.numTokens * sizeof(uint16);
+        memcpy(tokenInfo->types, at, header.numTokens * sizeof(uint8));
+
+        tokenInfo->contentHash = contentHash;
+        InvalidateLineHashes(editor);
+    }
+
+    FreeWin32(file);
+    return valid;
+}
+
+enum TokenSource
+{
+    TOKENS_NONE, //File isn't tokenisable
+    TOKENS_ALREADY_UP_TO_DATE,
+    TOKENS_FROM_CACHE,
+    TOKENS_LEXED
+};
+
+//Only lexes if neither the tokens we already have nor the ones in the token cache match the editor
+internal TokenSource TokeniseIfChanged(int editorIndex)
+{
+    if (numEditors > 3) return TOKENS_NONE;
+
+    Editor* editor = &editors[editorIndex];
+    Grammar* grammar = GetGrammarForFile(editor->fileName.toStr());
+    if (!grammar) return TOKENS_NONE; 
+
+    TokenInfo* tokenInfo = &tokenInfos[editorIndex];
+    uint64 contentHash = HashEditorContents(editor, grammar);
+    if (tokenInfo->numLines == editor->numLines && tokenInfo->contentHash == contentHash) 
+        return TOKENS_ALREADY_UP_TO_DATE;
+
+    if (LoadTokensFromCache(editorIndex, contentHash)) return TOKENS_FROM_CACHE;
+
+    TokeniseEditor(editor, grammar, tokenInfo, &definitions[editorIndex]);
+    tokenInfo->contentHash = contentHash;
+    return TOKENS_LEXED;
+}
+
+void OnFileOpen()
+{
+    if (TokeniseIfChanged(numEditors - 1) == TOKENS_LEXED)
+        SaveTokensToCache(numEditors - 1);
+}
+
+void OnTextChanged()
+{
+    Tokenise(openEditorIndexes[currentEditorSide]);
+}
+
+void OnEditorSwitch()
+{
+    TokeniseIfChanged(openEditorIndexes[currentEditorSide]);
+}
+
+//Takes the editor that was saved as the save finishes frames later, by which time it may not be the open one
+void OnFileSave(int editorIndex)
+{
+    //What's on disk now matches the editor, so these are the tokens we want next time the file is opened
+    TokenSource tokenSource = TokeniseIfChanged(editorIndex);
+    if (tokenSource == TOKENS_LEXED || tokenSource == TOKENS_ALREADY_UP_TO_DATE)
+        SaveTokensToCache(editorIndex);
+}
+
+//Lines with the same text and the same hash are drawn identically, whatever their token types are
+uint64 HashLineTokenColours(TokenInfo* tokenInfo, int lineIndex, uint64 seed)
+{
+    uint64 hash = seed;
+    for (int t = tokenInfo->lineSkipIndicies[lineIndex]; t < tokenInfo->lineSkipIndicies[lineIndex + 1]; ++t)
+    {
+        Colour colour = tokenColours.colours[tokenInfo->types[t]];
+        uint64 run = ((uint64)tokenInfo->textAts[t] << 40) | ((uint64)tokenInfo->lens[t] << 24) | 
+                     ((uint64)colour.r << 16) | ((uint64)colour.g << 8) | colour.b;
+        hash = HashBytes(&run, sizeof(run), hash);
+    }
+    return hash;
+}
+
+internal void AddColourRun(ColourRunList* list, int len, Colour colour)
+{
+    if (list->size == 0)
+    {
+        list->size = 64;
+        list->runs = HeapAlloc(ColourRun, list->size);
+    }
+
+    ColourRun run = {len, colour};
+    AppendToDynamicArray(list->runs, list->numRuns, run, list->size);
+}
+
+//Splits chars start to end of a line into runs of one colour, anything not in a token (like whitespace) is
+//the default text colour
+void GetLineColourRuns(string_buf line, TokenInfo* tokenInfo, int lineIndex, int start, int end, ColourRunList* list)
+{
+    PROFILE_FUNCTION();
+    list->numRuns = 0;
+    end = min(end, line.len);
+
+    //A line's tokens are in order, so skip to the last one that starts before start without going through the rest
+    int firstToken = tokenInfo->lineSkipIndicies[lineIndex];
+    int lastToken = tokenInfo->lineSkipIndicies[lineIndex + 1];
+    int low = firstToken;
+    int high = lastToken;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if ((int)tokenInfo->textAts[mid] <= start) low = mid + 1;
+        else high = mid;
+    }
+
+    int lineAt = start;
+    for (int t = max(low - 1, firstToken); t < lastToken; ++t)
+    {
+        //Tokens may be stale if the line changed since the last tokenise, so never read past the line
+        int tokenStart = max((int)tokenInfo->textAts[t], lineAt);
+        int tokenEnd = min((int)(tokenInfo->textAts[t] + tokenInfo->lens[t]), end);
+        if (tokenStart >= end) break;
+        if (tokenEnd <= tokenStart) continue;
+
+        if (tokenStart > lineAt) AddColourRun(list, tokenStart - lineAt, userSettings.defaultTextColour);
+        AddColourRun(list, tokenEnd - tokenStart, tokenColours.colours[tokenInfo->types[t]]);
+        lineAt = tokenEnd;
     }
 
+    if (lineAt < end) AddColourRun(list, end - lineAt, userSettings.defaultTextColour);
 }
\ No newline at end of file
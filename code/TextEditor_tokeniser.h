@@ -38,6 +38,8 @@ enum MultilineState
     MS_COMMENT
 };
 
+//NOTE: This is only an unpacked view of a token, used whilst lexing and when querying. Its text 
+//points into the editor's line so don't hold onto it past an edit.
 struct Token
 {
     EditorPos at;
@@ -45,15 +47,30 @@ struct Token
     TypeOfToken type;
 };
 
+//Tokens are stored as a structure of arrays with positions relative to the start of their line, 
+//so that reallocating a line never leaves a token pointing at freed memory.
 struct TokenInfo
 {
-    Token* tokens = nullptr;
-    int* lineSkipIndicies = nullptr;
+    uint32* textAts = nullptr;
+    uint16* lens = nullptr;
+    uint8* types = nullptr;
+    int* lineSkipIndicies = nullptr; //Index of first token on each line, has numLines + 1 entries
     int size = 256;
     int numTokens = 0;
+    int numLines = 0;
+
+    uint64 contentHash = 0; //Of the text and grammar these tokens were made from, see HashEditorContents
 };
 
 TokenInfo InitTokenInfo();
+void TokenInfo_AddToken(TokenInfo* tokenInfo, int textAt, int len, TypeOfToken type);
+
+int GetTokenIndexAtPos(TokenInfo* tokenInfo, EditorPos pos);
+Token GetTokenAtPos(Editor* editor, TokenInfo* tokenInfo, EditorPos pos);
 void LoadTokenColours(); //TODO: Make interface within files for customisation reasons
+void LoadGrammars();
+bool IsTokenisable(string fileName);
+uint64 HashLineTokenColours(TokenInfo* tokenInfo, int lineIndex, uint64 seed);
+void GetLineColourRuns(string_buf line, TokenInfo* tokenInfo, int lineIndex, int start, int end, ColourRunList* list);
 
 #endif
\ No newline at end of file
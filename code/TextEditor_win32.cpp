@@ -19,6 +19,9 @@
 #include "TextEditor_meta.h"
 #include "TextEditor_config.h"
 #include "TextEditor_tokeniser.h"
+#include "TextEditor_blit.h"
+#include "TextEditor_stats.h"
+#include "TextEditor_profile.h"
 
 #include "TextEditor_alloc.cpp"
 
@@ -36,11 +39,80 @@ global UserSettings userSettings;
 #include "TextEditor_meta.cpp"
 #include "TextEditor_config.cpp"
 #include "TextEditor_tokeniser.cpp"
+#include "TextEditor_blit.cpp"
+#include "TextEditor_stats.cpp"
+#include "TextEditor_profile.cpp"
 
 
 BITMAPINFO bitmapInfo;
 bool running;
 
+#define MAX_JOB_THREADS 64 //Including the main thread
+#define MAX_JOBS_PER_DEQUE 256
+#define MAX_PARKED_JOBS 64
+#define MAX_MAIN_THREAD_WORK 64
+
+struct Job
+{
+    WorkCallback callback;
+    void* data;
+    JobCounter* counter;
+    JobCounter* dependency;
+};
+
+//A Chase-Lev deque. Only the thread it belongs to adds and takes at the bottom, any thread can steal from the top.
+struct JobDeque
+{
+    int64 volatile top;
+    int64 volatile bottom;
+    Job jobs[MAX_JOBS_PER_DEQUE];
+};
+
+struct MainThreadWorkEntry
+{
+    WorkCallback callback;
+    void* data;
+    int32 volatile ready;
+};
+
+struct JobSystem
+{
+    JobDeque deques[MAX_JOB_THREADS]; //The main thread's is the first
+    JobDeque backgroundDeque; //Only the main thread adds to it and only the workers take from it
+    int numThreads; //Worker threads, not counting the main thread
+    HANDLE semaphore;
+
+    //Jobs whose dependency hasn't finished yet
+    int32 volatile parkedLock;
+    Job parked[MAX_PARKED_JOBS];
+    int numParked;
+
+    //Multiple producers, the main thread is the only consumer
+    int64 volatile nextMainThreadWorkToWrite;
+    int64 volatile nextMainThreadWorkToRead;
+    MainThreadWorkEntry mainThreadWork[MAX_MAIN_THREAD_WORK];
+    HANDLE mainThreadWorkEvent; //Wakes the main loop up when a job hands work back
+};
+
+global JobSystem jobSystem;
+thread_local int jobThreadIndex = 0;
+
+#define MAX_INPUT_EVENTS 256
+
+//Single producer (WindowProc), single consumer (the editor's Draw)
+struct InputEventQueue
+{
+    uint32 volatile nextEventToWrite;
+    uint32 volatile nextEventToRead;
+    InputEvent events[MAX_INPUT_EVENTS];
+};
+
+global InputEventQueue inputEventQueue;
+global int64 perfCountFreq;
+
+global InputRecording recording;
+global bool recordingInput = false;
+
 inline uint32 SafeTruncateSize32(uint64 val)
 {
     //TODO: Defines for max values
@@ -168,6 +240,15 @@ bool WriteToFile(string fileName, string text, bool overwrite, int32 writeStart)
     return result;
 }
 
+bool MakeDirectory(string dirName)
+{
+    char* dirNameCStr = dirName.cstr();
+    bool result = CreateDirectoryA(dirNameCStr, 0) || GetLastError() == ERROR_ALREADY_EXISTS;
+    free(dirNameCStr);
+
+    return result;
+}
+
 void CopyToClipboard(string text)
 {
     LPTSTR lptstrCopy; 
@@ -261,36 +342,54 @@ string ShowFileDialogAndGetFileName(bool save)
     return result;
 }
 
-inline void win32_HandleInputDown(byte* inputFlags)
+double GetSeconds()
 {
-    if (!InputHeld(*inputFlags)) 
-    {
-        *inputFlags |= INPUT_DOWN;
-        *inputFlags |= INPUT_HELD;
-    }
+    LARGE_INTEGER count;
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)perfCountFreq;
 }
 
-inline void win32_HandleInputUp(byte* inputFlags)
+internal void win32_PushInputEvent(InputEvent event)
+{
+    uint32 newNextEventToWrite = (inputEventQueue.nextEventToWrite + 1) % MAX_INPUT_EVENTS;
+    Assert(newNextEventToWrite != inputEventQueue.nextEventToRead);
+    if (newNextEventToWrite == inputEventQueue.nextEventToRead) return;
+
+    event.time = GetSeconds();
+    inputEventQueue.events[inputEventQueue.nextEventToWrite] = event;
+
+    _WriteBarrier();
+    inputEventQueue.nextEventToWrite = newNextEventToWrite;
+}
+
+bool PopInputEvent(InputEvent* event)
 {
-    *inputFlags &= ~INPUT_HELD;
-    *inputFlags |= INPUT_UP;
+    uint32 nextEventToRead = inputEventQueue.nextEventToRead;
+    if (nextEventToRead == inputEventQueue.nextEventToWrite) return false;
+
+    _ReadBarrier();
+    *event = inputEventQueue.events[nextEventToRead];
+
+    _ReadWriteBarrier();
+    inputEventQueue.nextEventToRead = (nextEventToRead + 1) % MAX_INPUT_EVENTS;
+
+    if (recordingInput) RecordInputEvent(&recording, event);
+    return true;
 }
 
-internal void win32_ProcessInput()
+//The flags are only used to get the input code, the editor sets them when it takes the event
+inline void win32_HandleInputDown(byte* inputFlags)
 {
-	input.scrollWheelDelta = 0.0f;
+    InputEvent event = {INPUTEVENT_DOWN};
+    event.code = (InputCode)(inputFlags - input.flags);
+    win32_PushInputEvent(event);
+}
 
-    for (int i = 0; i < NUM_INPUTS; ++i)
-    {
-        if (InputDown(input.flags[i]))
-        {
-            input.flags[i] &= ~INPUT_DOWN;
-        }
-        else if (InputUp(input.flags[i]))
-        {
-            input.flags[i] &= ~INPUT_UP;
-        }
-    }
+inline void win32_HandleInputUp(byte* inputFlags)
+{
+    InputEvent event = {INPUTEVENT_UP};
+    event.code = (InputCode)(inputFlags - input.flags);
+    win32_PushInputEvent(event);
 }
 
 void win32_LogInput(InputCode code)
@@ -321,6 +420,227 @@ void win32_LogInput(InputCode code)
         OutputDebugString(log);
 }
 
+internal void win32_PushJob(JobDeque* deque, Job job)
+{
+    int64 bottom = deque->bottom;
+    Assert(bottom - deque->top < MAX_JOBS_PER_DEQUE);
+    deque->jobs[bottom % MAX_JOBS_PER_DEQUE] = job;
+
+    _WriteBarrier();
+    deque->bottom = bottom + 1;
+    ReleaseSemaphore(jobSystem.semaphore, 1, 0);
+}
+
+//Only for the thread the deque belongs to, takes the job it added last
+internal bool win32_TakeJob(JobDeque* deque, Job* job)
+{
+    int64 bottom = deque->bottom - 1;
+    deque->bottom = bottom;
+    //Thieves have to see bottom go down before top is read, or two threads could get the last job
+    MemoryBarrier();
+    int64 top = deque->top;
+
+    bool result = false;
+    if (top <= bottom)
+    {
+        *job = deque->jobs[bottom % MAX_JOBS_PER_DEQUE];
+        result = true;
+        if (top == bottom)
+        {
+            //The last job, a thief could be taking it as well
+            result = InterlockedCompareExchange64((LONG64 volatile*)&deque->top, top + 1, top) == top;
+            deque->bottom = bottom + 1;
+        }
+    }
+    else
+    {
+        deque->bottom = bottom + 1;
+    }
+    return result;
+}
+
+//Takes the job that was added first, fails if another thread got to it first
+internal bool win32_StealJob(JobDeque* deque, Job* job)
+{
+    int64 top = deque->top;
+    MemoryBarrier();
+    int64 bottom = deque->bottom;
+    if (top >= bottom) return false;
+
+    *job = deque->jobs[top % MAX_JOBS_PER_DEQUE];
+    return InterlockedCompareExchange64((LONG64 volatile*)&deque->top, top + 1, top) == top;
+}
+
+inline void win32_LockParkedJobs()
+{
+    while (InterlockedCompareExchange((LONG volatile*)&jobSystem.parkedLock, 1, 0) != 0)
+        YieldProcessor();
+}
+
+inline void win32_UnlockParkedJobs()
+{
+    InterlockedExchange((LONG volatile*)&jobSystem.parkedLock, 0);
+}
+
+internal void win32_ReleaseParkedJobs()
+{
+    win32_LockParkedJobs();
+    for (int i = 0; i < jobSystem.numParked;)
+    {
+        if (jobSystem.parked[i].dependency->count == 0)
+        {
+            win32_PushJob(&jobSystem.deques[jobThreadIndex], jobSystem.parked[i]);
+            jobSystem.parked[i] = jobSystem.parked[--jobSystem.numParked];
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    win32_UnlockParkedJobs();
+}
+
+//Returns whether there was a job to run
+internal bool win32_RunNextJob()
+{
+    Job job;
+    bool found = win32_TakeJob(&jobSystem.deques[jobThreadIndex], &job);
+
+    //Each thread starts stealing from the one after it, so they don't all go for the same deque
+    for (int i = 1; !found && i <= jobSystem.numThreads; ++i)
+    {
+        int victim = (jobThreadIndex + i) % (jobSystem.numThreads + 1);
+        found = win32_StealJob(&jobSystem.deques[victim], &job);
+    }
+
+    //Background work is only picked up once there's nothing else, and never by the main thread so it 
+    //can't hold a frame up whilst it waits on its own jobs
+    if (!found && jobThreadIndex != 0)
+        found = win32_StealJob(&jobSystem.backgroundDeque, &job);
+
+    if (found)
+    {
+        job.callback(job.data);
+        if (job.counter && InterlockedDecrement((LONG volatile*)&job.counter->count) == 0)
+            win32_ReleaseParkedJobs();
+    }
+    return found;
+}
+
+void AddWork(WorkCallback callback, void* data, JobCounter* counter, JobCounter* dependency)
+{
+    Job job = {callback, data, counter, dependency};
+    if (counter) InterlockedIncrement((LONG volatile*)&counter->count);
+
+    //Checked under the lock so the dependency can't finish between being checked and the job being parked
+    if (dependency)
+    {
+        win32_LockParkedJobs();
+        bool parked = dependency->count != 0;
+        if (parked)
+        {
+            Assert(jobSystem.numParked < MAX_PARKED_JOBS);
+            jobSystem.parked[jobSystem.numParked++] = job;
+        }
+        win32_UnlockParkedJobs();
+        if (parked) return;
+    }
+
+    win32_PushJob(&jobSystem.deques[jobThreadIndex], job);
+}
+
+void AddBackgroundWork(WorkCallback callback, void* data, JobCounter* counter)
+{
+    Assert(jobThreadIndex == 0);
+
+    //Nothing would ever take it without workers
+    if (jobSystem.numThreads == 0)
+    {
+        callback(data);
+        return;
+    }
+
+    Job job = {callback, data, counter, nullptr};
+    if (counter) InterlockedIncrement((LONG volatile*)&counter->count);
+    win32_PushJob(&jobSystem.backgroundDeque, job);
+}
+
+void WaitForCounter(JobCounter* counter)
+{
+    while (counter->count != 0)
+    {
+        if (!win32_RunNextJob()) YieldProcessor();
+    }
+    _ReadBarrier();
+}
+
+int GetNumWorkerThreads()
+{
+    return jobSystem.numThreads;
+}
+
+int GetJobThreadIndex()
+{
+    return jobThreadIndex;
+}
+
+void AddMainThreadWork(WorkCallback callback, void* data)
+{
+    int64 index = InterlockedIncrement64((LONG64 volatile*)&jobSystem.nextMainThreadWorkToWrite) - 1;
+    Assert(index - jobSystem.nextMainThreadWorkToRead < MAX_MAIN_THREAD_WORK);
+
+    MainThreadWorkEntry* entry = &jobSystem.mainThreadWork[index % MAX_MAIN_THREAD_WORK];
+    entry->callback = callback;
+    entry->data = data;
+
+    _WriteBarrier();
+    entry->ready = 1;
+    SetEvent(jobSystem.mainThreadWorkEvent);
+}
+
+void RunMainThreadWork()
+{
+    while (true)
+    {
+        MainThreadWorkEntry* entry = &jobSystem.mainThreadWork[jobSystem.nextMainThreadWorkToRead % MAX_MAIN_THREAD_WORK];
+        if (!entry->ready) break;
+
+        _ReadBarrier();
+        MainThreadWorkEntry work = *entry;
+        _ReadWriteBarrier();
+        entry->ready = 0;
+        jobSystem.nextMainThreadWorkToRead++;
+
+        work.callback(work.data);
+    }
+}
+
+DWORD WINAPI win32_WorkerThreadProc(LPVOID param)
+{
+    jobThreadIndex = (int)(size_t)param;
+    while (true)
+    {
+        if (!win32_RunNextJob())
+            WaitForSingleObjectEx(jobSystem.semaphore, INFINITE, FALSE);
+    }
+}
+
+internal void win32_InitJobSystem()
+{
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+
+    //Main thread also does work whilst waiting so leave a core for it
+    jobSystem.numThreads = Clamp((int)systemInfo.dwNumberOfProcessors - 1, 0, MAX_JOB_THREADS - 1);
+    jobSystem.semaphore = CreateSemaphoreEx(0, 0, max(jobSystem.numThreads, 1), 0, 0, SEMAPHORE_ALL_ACCESS);
+    jobSystem.mainThreadWorkEvent = CreateEvent(0, FALSE, FALSE, 0);
+    for (int i = 1; i <= jobSystem.numThreads; ++i)
+    {
+        HANDLE threadHandle = CreateThread(0, 0, win32_WorkerThreadProc, (LPVOID)(size_t)i, 0, 0);
+        CloseHandle(threadHandle);
+    }
+}
+
 //DIB: Device Independent Bitmap
 internal void win32_ResizeDIB(int width, int height)
 {
@@ -344,16 +664,22 @@ internal void win32_ResizeDIB(int width, int height)
 
 }
 
-internal void win32_UpdateWindow(HDC deviceContext, int x, int y, int width, int height)
+//Rect is in screen buffer coordinates, which start at the bottom left of the window
+internal void win32_UpdateWindow(HDC deviceContext, Rect rect)
 {
-    StretchDIBits(
-        deviceContext, 
-        0, 0, screenBuffer.width, screenBuffer.height,
-        x, y, width, height,
+    rect = IntersectRects(rect, Rect {0, screenBuffer.width, 0, screenBuffer.height});
+    if (RectIsEmpty(rect)) return;
+
+    //The DIB is bottom up, so the source is given by its bottom left but the destination by its top left
+    SetDIBitsToDevice(
+        deviceContext,
+        rect.left, screenBuffer.height - rect.top,
+        rect.right - rect.left, rect.top - rect.bottom,
+        rect.left, rect.bottom,
+        0, screenBuffer.height,
         screenBuffer.memory,
         &bitmapInfo,
-        DIB_RGB_COLORS,
-        SRCCOPY);
+        DIB_RGB_COLORS);
 }
 
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
@@ -363,7 +689,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 {
     LARGE_INTEGER perfCountFreqResult;
     QueryPerformanceFrequency(&perfCountFreqResult);
-    int64 perfCountFreq = perfCountFreqResult.QuadPart;
+    perfCountFreq = perfCountFreqResult.QuadPart;
 
 
     // Register the window class.
@@ -400,47 +726,41 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 
     userSettings = LoadUserSettingsFromConfigFile();
 
-    stbtt_fontinfo fontInfo;
-    uchar* ttfFile = (uchar*)ReadEntireFile(userSettings.fontFile);
-    stbtt_InitFont(&fontInfo, ttfFile, stbtt_GetFontOffsetForIndex(ttfFile, 0));
-
-    int offsetAboveBaseline, offsetBelowBaseline, lineGap;
-    stbtt_GetFontVMetrics(&fontInfo, &offsetAboveBaseline, &offsetBelowBaseline, &lineGap);
-    float scale = stbtt_ScaleForPixelHeight(&fontInfo, 
-                                            (float)PointsToPix(fontSizes[fontData.sizeIndex]));
-
-    fontData.maxHeight = (uint32)RoundToInt((offsetAboveBaseline - offsetBelowBaseline) * scale);
-    fontData.lineGap = (uint32)RoundToInt(lineGap * scale);
-    fontData.offsetBelowBaseline = (uint32)RoundToInt(-offsetBelowBaseline * scale);
-
-    for (uchar c = 0; c < 128; ++c)
-    {
-        FontChar fc;
-        
-        int width, height, xOffset, yOffset, advance, lsb;
-        fc.pixels = stbtt_GetCodepointBitmap(&fontInfo, 0, scale, c, &width, &height, &xOffset, &yOffset);
-        stbtt_GetCodepointHMetrics(&fontInfo, c, &advance, &lsb);
-
-        fc.width = width;
-        fc.height = height;
-        fc.left = xOffset;
-        fc.top = yOffset;
-        fc.advance = (uint32)RoundToInt(advance * scale);
-        fontData.chars[c] = fc;
-    }    
+    ShowWindow(hwnd, nCmdShow);
 
-    FreeWin32(ttfFile);
+    win32_InitJobSystem();
 
-    ShowWindow(hwnd, nCmdShow);
+    //After the job system is up, other sizes get rasterised on it
+    ChangeFont(userSettings.fontFile);
 
     running = true;
     int64 prevCount = 0;
 
+    //-record <file> saves the input the editor takes so the session can be replayed by the headless layer
+    wchar* recordFileName = NULL;
+    if (wcsncmp(pCmdLine, L"-record ", 8) == 0)
+    {
+        recordFileName = pCmdLine + 8;
+        StartInputRecording(&recording);
+        recordingInput = true;
+    }
+
 
     Init();
 
+    //Lets the waits below wake up within a millisecond of when they're asked to, instead of a whole scheduler tick
+    timeBeginPeriod(1);
+
     while (running)
     { 
+        //Sleep until a message comes in or one of the editor's timers is due, rather than spinning on PeekMessage
+        float waitSeconds = SecondsUntilNextDraw();
+        if (waitSeconds != 0.0f)
+        {
+            DWORD waitMs = (waitSeconds < 0.0f) ? INFINITE : (DWORD)(waitSeconds * 1000.0f) + 1;
+            MsgWaitForMultipleObjectsEx(1, &jobSystem.mainThreadWorkEvent, waitMs, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+        }
+
         LARGE_INTEGER currentCountResult;
         QueryPerformanceCounter(&currentCountResult);
         int64 currentCount = currentCountResult.QuadPart;
@@ -457,7 +777,6 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
         //wchar log[100];
         //swprintf_s(log, L"MousePos: {%i, %i}.\n", input.mousePixelPos.x, input.mousePixelPos.y);
         //OutputDebugString(log);
-        win32_ProcessInput();
 
         //If the text editor is not the current app, reset the input
         HWND currentWindow = GetForegroundWindow();
@@ -473,18 +792,36 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
             DispatchMessageA(&msg);
         }
 
-        Draw(deltaTime);
+        if (recordingInput) BeginRecordedFrame(&recording, deltaTime);
+
+        DirtyRects dirtyRects;
+        Draw(deltaTime, &dirtyRects);
         
-        HDC hdc = GetDC(hwnd);
-        RECT windowRect;
-        GetClientRect(hwnd, &windowRect);
-        int windowWidth = windowRect.right - windowRect.left;
-        int windowHeight = windowRect.bottom - windowRect.top;
-        win32_UpdateWindow(hdc, 0, 0, windowWidth, windowHeight);
-        ReleaseDC(hwnd, hdc);
+        //Only what changed gets sent to the window, usually nothing or just the cursor
+        if (dirtyRects.numRects)
+        {
+            HDC hdc = GetDC(hwnd);
+            for (int i = 0; i < dirtyRects.numRects; ++i)
+                win32_UpdateWindow(hdc, dirtyRects.rects[i]);
+            ReleaseDC(hwnd, hdc);
+        }
+        FramePresented();
 
         FlushStringArena(&temporaryStringArena);
     }
+
+    timeEndPeriod(1);
+    FinishBackgroundWork();
+
+    //Resizing the window isn't recorded, so the replay uses the size it ended at
+    if (recordingInput)
+    {
+        char fileName[MAX_PATH];
+        wcstombs_s(0, fileName, sizeof(fileName), recordFileName, _TRUNCATE);
+        if (!SaveInputRecording(&recording, cstring(fileName), screenBuffer.width, screenBuffer.height))
+            win32_LogError();
+    }
+
     return 0;
 }
 
@@ -499,6 +836,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             int width = clientRect.right - clientRect.left;
             int height = clientRect.bottom - clientRect.top;
             win32_ResizeDIB(width, height);
+            InvalidateScreen();
         } return 0;
 
         case WM_CLOSE:
@@ -516,15 +854,15 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             PAINTSTRUCT paint;
             HDC hdc = BeginPaint(hwnd, &paint);
 
-            
-            int x = paint.rcPaint.left;
-            int y = paint.rcPaint.top;
-            int width = paint.rcPaint.right - paint.rcPaint.left;
-            int height = paint.rcPaint.bottom - paint.rcPaint.top;
-
-            RECT clientRect;
-            GetClientRect(hwnd, &clientRect);
-            win32_UpdateWindow(hdc, x, y, width, height);
+            //The screen buffer still has the whole last frame in it, so just present the part asked for
+            Rect paintRect = 
+            {
+                paint.rcPaint.left, 
+                paint.rcPaint.right, 
+                screenBuffer.height - paint.rcPaint.bottom, 
+                screenBuffer.height - paint.rcPaint.top
+            };
+            win32_UpdateWindow(hdc, paintRect);
 
 
             EndPaint(hwnd, &paint);
@@ -556,17 +894,26 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             return 0;
 
         case WM_MOUSEWHEEL:
-			input.scrollWheelDelta = (float)GET_WHEEL_DELTA_WPARAM(wParam) / WHEEL_DELTA;
-            return 0;
+        {
+            InputEvent event = {INPUTEVENT_SCROLL};
+            event.scrollWheelDelta = (float)GET_WHEEL_DELTA_WPARAM(wParam) / WHEEL_DELTA;
+            win32_PushInputEvent(event);
+        } return 0;
 
         case WM_MOUSEMOVE:
-            input.mousePixelPos.x = GET_X_LPARAM(lParam); 
-            input.mousePixelPos.y = screenBuffer.height - GET_Y_LPARAM(lParam);
-            return 0;
+        {
+            InputEvent event = {INPUTEVENT_MOUSE_MOVE};
+            event.mousePixelPos.x = GET_X_LPARAM(lParam); 
+            event.mousePixelPos.y = screenBuffer.height - GET_Y_LPARAM(lParam);
+            win32_PushInputEvent(event);
+        } return 0;
 
         case WM_SYSKEYDOWN:
         case WM_KEYDOWN:
         {
+            //Bit 30 is set on the OS's own key repeats, the editor does its own
+            if (lParam & (1 << 30)) return 0;
+
             uint32 vkCode = (uint32)wParam;
             if (vkCode >= (uint32)'A' && vkCode <= (uint32)'Z')
                 win32_HandleInputDown(&input.letterKeys[vkCode - 'A']);
@@ -574,10 +921,8 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 win32_HandleInputDown(&input.numberKeys[vkCode - '0']);
             else if (vkCode >= VK_LEFT && vkCode <= VK_DOWN)
                 win32_HandleInputDown(&input.arrowKeys[vkCode - VK_LEFT]);
-            //else if (vkCode >= VK_F1 && <= VK_F12)
-            //    win32_HandleInputDown(&input.fKeys[vkCode - VK_F1]);
-            else if (vkCode == VK_F5)
-                win32_HandleInputDown(&input.f5);
+            else if (vkCode >= VK_F1 && vkCode <= VK_F12)
+                win32_HandleInputDown(&input.fKeys[vkCode - VK_F1]);
             else if (vkCode == VK_BACK)
                 win32_HandleInputDown(&input.backspace);
             else if (vkCode == VK_SHIFT || vkCode == VK_LSHIFT)
@@ -628,10 +973,8 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 win32_HandleInputUp(&input.numberKeys[vkCode - '0']);
             else if (vkCode >= VK_LEFT && vkCode <= VK_DOWN)
                 win32_HandleInputUp(&input.arrowKeys[vkCode - VK_LEFT]);
-            //else if (vkCode >= VK_F1 && <= VK_F12)
-            //    win32_HandleInputUp(&input.fKeys[vkCode - VK_F1]);
-            else if (vkCode == VK_F5)
-                win32_HandleInputUp(&input.f5);
+            else if (vkCode >= VK_F1 && vkCode <= VK_F12)
+                win32_HandleInputUp(&input.fKeys[vkCode - VK_F1]);
             else if (vkCode == VK_BACK)
                 win32_HandleInputUp(&input.backspace);
             else if (vkCode == VK_SHIFT || vkCode == VK_LSHIFT)
@@ -0,0 +1,39 @@
+#include <stdio.h>
+
+#define MAX_SHAPES 16
+
+typedef float real;
+
+enum ShapeType
+{
+    SHAPE_CIRCLE,
+    SHAPE_SQUARE,
+};
+
+struct Shape
+{
+    ShapeType type;
+    real size; //Radius or side length
+};
+
+/* Areas of every shape in the list,
+   written to areas */
+void GetAreas(Shape* shapes, int numShapes, real* areas)
+{
+    for (int i = 0; i < numShapes && i < MAX_SHAPES; ++i)
+    {
+        if (shapes[i].type == SHAPE_CIRCLE)
+            areas[i] = 3.14159f * shapes[i].size * shapes[i].size;
+        else
+            areas[i] = shapes[i].size * shapes[i].size;
+    }
+}
+
+int main()
+{
+    Shape shapes[] = {{SHAPE_CIRCLE, 1.5f}, {SHAPE_SQUARE, 2.0f}};
+    real areas[MAX_SHAPES];
+    GetAreas(shapes, 2, areas);
+    printf("%f %f\n", areas[0], areas[1]);
+    return 0;
+}